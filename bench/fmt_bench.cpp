@@ -0,0 +1,249 @@
+// Micro-benchmark: the fmt.h kernel against the stream-based helpers the
+// render path used before (kept here verbatim as the baseline).
+//
+//   winbtop_fmt_bench [iterations]
+
+#include "fmt.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace legacy
+{
+std::wstring PadRight(std::wstring s, size_t width)
+{
+    if (s.size() >= width)
+        return s.substr(0, width);
+    s.append(width - s.size(), L' ');
+    return s;
+}
+
+std::wstring FormatBytes(unsigned long long bytes)
+{
+    static const wchar_t *units[] = {L"B", L"KiB", L"MiB", L"GiB", L"TiB"};
+    int u = 0;
+    long double val = (long double)bytes;
+    while (val >= 1024.0 && u < 4)
+    {
+        val /= 1024.0;
+        ++u;
+    }
+    std::wstringstream ss;
+    ss << std::fixed << std::setprecision(val >= 100 ? 0 : (val >= 10 ? 1 : 2))
+       << val << L" " << units[u];
+    return ss.str();
+}
+
+std::wstring Ellipsis(std::wstring s, size_t w)
+{
+    if (w == 0)
+        return L"";
+    if (s.size() <= w)
+        return PadRight(std::move(s), w);
+    if (w <= 1)
+        return s.substr(0, w);
+    return s.substr(0, w - 1) + L"…";
+}
+
+std::wstring MiddleEllipsis(const std::wstring &s, size_t w)
+{
+    if (w == 0)
+        return L"";
+    if (s.size() <= w)
+        return PadRight(s, w);
+    if (w <= 1)
+        return s.substr(0, w);
+    size_t left = (w - 1) / 2;
+    size_t right = (w - 1) - left;
+    return s.substr(0, left) + L"…" + s.substr(s.size() - right);
+}
+
+template <class T>
+std::wstring Field(T v, int w, int prec = -1)
+{
+    std::wstringstream ss;
+    if (prec >= 0)
+        ss << std::fixed << std::setprecision(prec);
+    ss << std::setw(w) << v;
+    return ss.str();
+}
+} // namespace legacy
+
+// Stand-in for a grid row: the kernel writes cells, the legacy path copies
+// its temporary string into the same row.
+struct RowOut
+{
+    char32_t cells[512];
+    int n = 0;
+    void Put(char32_t c)
+    {
+        if (n < 512)
+            cells[n++] = c;
+    }
+    void Copy(const std::wstring &s)
+    {
+        for (wchar_t c : s)
+            Put((char32_t)c);
+    }
+    std::wstring Str() const
+    {
+        std::wstring s;
+        for (int i = 0; i < n; ++i)
+            s.push_back((wchar_t)cells[i]);
+        return s;
+    }
+};
+
+struct Sample
+{
+    unsigned pid;
+    unsigned threads;
+    unsigned long long bytes;
+    double cpu;
+    std::wstring name;
+    std::wstring cmd;
+};
+
+static std::vector<Sample> MakeSamples(size_t n)
+{
+    std::vector<Sample> v;
+    v.reserve(n);
+    uint64_t x = 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i < n; ++i)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        Sample s;
+        s.pid = (unsigned)(x % 60000);
+        s.threads = (unsigned)(x % 300);
+        s.bytes = x % (64ull << 30) >> (x % 24);
+        s.cpu = (double)(x % 10000) / 97.0;
+        s.name = L"process_" + std::to_wstring(i) + L".exe";
+        s.cmd = L"C:\\Program Files\\Vendor\\Product\\bin\\process_" + std::to_wstring(i) +
+                L".exe --service --config=C:\\ProgramData\\Vendor\\settings.json";
+        v.push_back(std::move(s));
+    }
+    return v;
+}
+
+using Clock = std::chrono::steady_clock;
+
+template <class F>
+static double NsPerOp(size_t iters, size_t perIter, F &&f)
+{
+    auto t0 = Clock::now();
+    for (size_t i = 0; i < iters; ++i)
+        f();
+    auto t1 = Clock::now();
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / (double)(iters * perIter);
+}
+
+int main(int argc, char **argv)
+{
+    const size_t iters = argc > 1 ? (size_t)std::strtoull(argv[1], nullptr, 10) : 200;
+    const auto samples = MakeSamples(1000);
+    const int nameW = 16, cmdW = 40, memW = 11, cpuW = 6, pidW = 5;
+
+    // The kernel must produce exactly what the old helpers produced.
+    int mismatches = 0;
+    for (const auto &s : samples)
+    {
+        RowOut a, b;
+        a.Copy(legacy::Field(s.pid, pidW));
+        a.Copy(legacy::Ellipsis(s.name, nameW));
+        a.Copy(legacy::MiddleEllipsis(s.cmd, cmdW));
+        a.Copy(legacy::PadRight(legacy::FormatBytes(s.bytes), memW));
+        a.Copy(legacy::Field(s.cpu, cpuW, 1));
+        FmtUInt(b, s.pid, pidW);
+        FmtEllipsis(b, s.name, nameW);
+        FmtMiddleEllipsis(b, s.cmd, cmdW);
+        FmtBytes(b, s.bytes, memW);
+        FmtFixed(b, s.cpu, 1, cpuW);
+        if (a.Str() != b.Str())
+        {
+            if (++mismatches <= 5)
+                std::printf("mismatch:\n  legacy '%ls'\n  kernel '%ls'\n", a.Str().c_str(), b.Str().c_str());
+        }
+    }
+
+    volatile char32_t sink = 0;
+    const size_t n = samples.size();
+
+    struct Case
+    {
+        const char *name;
+        double legacyNs, kernelNs;
+    };
+    std::vector<Case> cases;
+
+    auto run = [&](const char *name, auto legacyFn, auto kernelFn)
+    {
+        double l = NsPerOp(iters, n, [&]
+                           {
+            for (const auto &s : samples)
+            {
+                RowOut o;
+                legacyFn(o, s);
+                sink = sink + o.cells[0];
+            } });
+        double k = NsPerOp(iters, n, [&]
+                           {
+            for (const auto &s : samples)
+            {
+                RowOut o;
+                kernelFn(o, s);
+                sink = sink + o.cells[0];
+            } });
+        cases.push_back({name, l, k});
+    };
+
+    run("uint", [&](RowOut &o, const Sample &s)
+        { o.Copy(legacy::Field(s.pid, pidW)); },
+        [&](RowOut &o, const Sample &s)
+        { FmtUInt(o, s.pid, pidW); });
+    run("fixed1", [&](RowOut &o, const Sample &s)
+        { o.Copy(legacy::Field(s.cpu, cpuW, 1)); },
+        [&](RowOut &o, const Sample &s)
+        { FmtFixed(o, s.cpu, 1, cpuW); });
+    run("bytes", [&](RowOut &o, const Sample &s)
+        { o.Copy(legacy::PadRight(legacy::FormatBytes(s.bytes), memW)); },
+        [&](RowOut &o, const Sample &s)
+        { FmtBytes(o, s.bytes, memW); });
+    run("ellipsis", [&](RowOut &o, const Sample &s)
+        { o.Copy(legacy::Ellipsis(s.name, nameW)); },
+        [&](RowOut &o, const Sample &s)
+        { FmtEllipsis(o, s.name, nameW); });
+    run("middle_ellipsis", [&](RowOut &o, const Sample &s)
+        { o.Copy(legacy::MiddleEllipsis(s.cmd, cmdW)); },
+        [&](RowOut &o, const Sample &s)
+        { FmtMiddleEllipsis(o, s.cmd, cmdW); });
+    run("process_row", [&](RowOut &o, const Sample &s)
+        {
+            o.Copy(legacy::Field(s.pid, pidW));
+            o.Copy(legacy::Ellipsis(s.name, nameW));
+            o.Copy(legacy::MiddleEllipsis(s.cmd, cmdW));
+            o.Copy(legacy::Field(s.threads, 7));
+            o.Copy(legacy::PadRight(legacy::FormatBytes(s.bytes), memW));
+            o.Copy(legacy::Field(s.cpu, cpuW, 1)); },
+        [&](RowOut &o, const Sample &s)
+        {
+            FmtUInt(o, s.pid, pidW);
+            FmtEllipsis(o, s.name, nameW);
+            FmtMiddleEllipsis(o, s.cmd, cmdW);
+            FmtUInt(o, s.threads, 7);
+            FmtBytes(o, s.bytes, memW);
+            FmtFixed(o, s.cpu, 1, cpuW); });
+
+    std::printf("%-16s %12s %12s %8s\n", "case", "legacy ns/op", "kernel ns/op", "speedup");
+    for (const auto &c : cases)
+        std::printf("%-16s %12.1f %12.1f %7.1fx\n", c.name, c.legacyNs, c.kernelNs, c.legacyNs / c.kernelNs);
+    std::printf("mismatches: %d\n", mismatches);
+    return mismatches ? 1 : 0;
+}
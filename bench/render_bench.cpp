@@ -0,0 +1,357 @@
+// Headless render benchmark: builds frames from synthetic snapshots through
+// the same BuildFrame / ComposeFrame / Screen::Present path the app uses, with no
+// console attached. Prints one JSON object per case on stdout.
+//
+//   winbtop_render_bench [--themes DIR] [--theme NAME] [--frames N] [--procs N]
+//                        [--colors truecolor|256|16] [--workers N]
+//
+// The "parallel" cases draw the same sample frames once serially and once
+// on the worker pool regardless of size, to find where the pool starts to
+// pay off.
+
+#include "ui.h"
+#include "ui_graph.h"
+#include "screen.h"
+#include "theme.h"
+#include "state.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef WINBTOP_BENCH_THEMES
+#define WINBTOP_BENCH_THEMES "themes"
+#endif
+
+// Every heap allocation in the process goes through here.
+static std::atomic<uint64_t> g_allocs{0};
+
+void *operator new(std::size_t n)
+{
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+struct Rng
+{
+    uint64_t x = 0x9E3779B97F4A7C15ull;
+    uint64_t Next()
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        return x;
+    }
+    double Unit() { return (double)(Next() >> 11) / (double)(1ull << 53); }
+};
+
+static std::vector<ProcInfo> MakeProcs(size_t n, Rng &rng)
+{
+    static const wchar_t *const names[] = {
+        L"svchost.exe", L"explorer.exe", L"chrome.exe", L"Code.exe", L"RuntimeBroker.exe",
+        L"conhost.exe", L"msedgewebview2.exe", L"SearchIndexer.exe", L"dwm.exe", L"winbtop.exe"};
+    static const wchar_t *const users[] = {L"SYSTEM", L"LOCAL SERVICE", L"NETWORK SERVICE", L"user"};
+
+    std::vector<ProcInfo> v(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        ProcInfo &p = v[i];
+        p.pid = (DWORD)(4 + i * 4);
+        const wchar_t *name = names[rng.Next() % 10];
+        p.name = Strings().Intern(name);
+        p.user = Strings().Intern(users[rng.Next() % 4]);
+        if (rng.Next() % 5)
+            p.cmdline = Strings().Intern(std::wstring(L"C:\\Windows\\System32\\") + name +
+                                         L" -k netsvcs -p -s Service" + std::to_wstring(i));
+        p.workingSet = (SIZE_T)(rng.Next() % (2ull << 30));
+        p.threads = (DWORD)(1 + rng.Next() % 120);
+        p.cpu_percent = rng.Unit() < 0.8 ? 0.0 : rng.Unit() * 100.0;
+        FormatProcText(p);
+    }
+    return v;
+}
+
+// What changes between two samples: a tenth of the processes move.
+static void Perturb(std::vector<ProcInfo> &procs, Rng &rng)
+{
+    const size_t n = procs.size(), step = n / 10 + 1;
+    for (size_t k = 0; k < step; ++k)
+    {
+        ProcInfo &p = procs[rng.Next() % n];
+        p.cpu_percent = rng.Unit() * 100.0;
+        p.workingSet = (SIZE_T)(p.workingSet + rng.Next() % (1u << 20));
+        FormatProcText(p);
+    }
+}
+
+enum class Scenario
+{
+    Idle,   // nothing changed since the previous frame
+    Sample, // new snapshot every frame
+    Menu,   // new snapshot with the main menu on top
+    Help,   // new snapshot with the help overlay on top
+    Scroll, // same snapshot, table wheel-scrolled by three rows
+};
+
+static const char *ScenarioName(Scenario s)
+{
+    switch (s)
+    {
+    case Scenario::Idle:
+        return "idle";
+    case Scenario::Sample:
+        return "sample";
+    case Scenario::Menu:
+        return "menu";
+    case Scenario::Scroll:
+        return "scroll";
+    default:
+        return "help";
+    }
+}
+
+struct Result
+{
+    double nsPerFrame = 0;
+    double bytesPerFrame = 0;
+    double allocsPerFrame = 0;
+};
+
+using Clock = std::chrono::steady_clock;
+
+static Result RunCase(short cols, short rows, size_t procCount, Scenario sc, int frames)
+{
+    Rng rng;
+    // The snapshot owns the references MakeProcs() interned, as a published
+    // one does, and drops them when the case is done.
+    Snapshot snap;
+    snap.procs = MakeProcs(procCount, rng);
+    std::vector<ProcInfo> &procs = snap.procs;
+    const Layout L = ComputeLayout(cols, rows);
+
+    AppState st;
+    const std::wstring themeName = L"bench";
+    if (sc == Scenario::Menu)
+        st.ui = UiMode::MainMenu;
+    else if (sc == Scenario::Help)
+        st.ui = UiMode::Help;
+    std::vector<double> perCore(16);
+    Ring<double> diskHist, netHist, cpuHist, memHist;
+    for (int i = 0; i < 180; ++i)
+    {
+        diskHist.push(rng.Unit() * 1e8);
+        netHist.push(rng.Unit() * 1e7);
+        cpuHist.push(rng.Unit() * 100.0);
+        memHist.push(30.0 + rng.Unit() * 10.0);
+    }
+
+    Screen screen;
+    screen.Resize(cols, rows);
+    std::string out;
+    out.reserve(1 << 20);
+    double cpu = 12.5;
+    MemInfo mem{32ull << 30, 20ull << 30, 12ull << 30, 37.5};
+    std::wstring netLine = L"net : \x2191 1.20 MiB/s | \x2193 340 KiB/s";
+    std::wstring diskLine = L"disk: R 12.0 MiB/s | W 3.40 MiB/s";
+
+    int scroll = 0;
+    unsigned long long generation = 0;
+    auto frame = [&]
+    {
+        if (sc == Scenario::Scroll)
+            scroll = (scroll + 3) % std::max<int>(1, (int)procs.size() / 2);
+        else if (sc != Scenario::Idle)
+        {
+            Perturb(procs, rng);
+            ++generation;
+            cpu = rng.Unit() * 100.0;
+            for (double &c : perCore)
+                c = rng.Unit() * 100.0;
+            diskHist.push(rng.Unit() * 1e8);
+            netHist.push(rng.Unit() * 1e7);
+            cpuHist.push(cpu);
+            memHist.push(30.0 + rng.Unit() * 10.0);
+        }
+        const std::wstring diskSpark = spark_braille(diskHist.data(), 24);
+        const std::wstring netSpark = spark_braille(netHist.data(), 24);
+        BuildFrame(screen.Back(), L, cpu, mem, procs, generation, 5, perCore,
+                   netLine, diskLine, netSpark, diskSpark, cpuHist, memHist, 0, scroll, scroll);
+        ComposeFrame(screen.Back(), L, st, themeName);
+        out.clear();
+        screen.Present(out);
+        return out.size();
+    };
+
+    // The first frame is a full repaint; measure steady state.
+    frame();
+    frame();
+
+    uint64_t bytes = 0;
+    const uint64_t allocs0 = g_allocs.load(std::memory_order_relaxed);
+    const auto t0 = Clock::now();
+    for (int i = 0; i < frames; ++i)
+        bytes += frame();
+    const auto t1 = Clock::now();
+    const uint64_t allocs = g_allocs.load(std::memory_order_relaxed) - allocs0;
+
+    Result r;
+    r.nsPerFrame = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / frames;
+    r.bytesPerFrame = (double)bytes / frames;
+    r.allocsPerFrame = (double)allocs / frames;
+    return r;
+}
+
+static void BenchSpark(int calls)
+{
+    Rng rng;
+    Ring<double> hist;
+    for (int i = 0; i < 180; ++i)
+        hist.push(rng.Unit());
+
+    size_t sink = 0;
+    const uint64_t allocs0 = g_allocs.load(std::memory_order_relaxed);
+    const auto t0 = Clock::now();
+    for (int i = 0; i < calls; ++i)
+    {
+        hist.push(rng.Unit());
+        sink += spark_braille(hist.data(), 24).size();
+    }
+    const auto t1 = Clock::now();
+    const uint64_t allocs = g_allocs.load(std::memory_order_relaxed) - allocs0;
+
+    std::printf("{\"bench\":\"spark_braille\",\"width\":24,\"calls\":%d,\"ns_per_call\":%.1f,"
+                "\"allocs_per_call\":%.2f,\"chars\":%zu}\n",
+                calls,
+                (double)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / calls,
+                (double)allocs / calls, sink / (size_t)calls);
+}
+
+static void BenchParallel(short cols, short rows, size_t procCount, int workers, int frames)
+{
+    SetParallelRender(0, 0);
+    const Result serial = RunCase(cols, rows, procCount, Scenario::Sample, frames);
+    SetParallelRender(workers, 0);
+    const Result parallel = RunCase(cols, rows, procCount, Scenario::Sample, frames);
+
+    // The pair is always timed; "app_parallel" says whether the app would
+    // draw this size in parallel.
+    std::printf("{\"bench\":\"parallel\",\"cols\":%d,\"rows\":%d,\"cells\":%d,\"procs\":%zu,\"workers\":%d,"
+                "\"app_parallel\":%s,\"serial_ns\":%.0f,\"parallel_ns\":%.0f,\"speedup\":%.2f,"
+                "\"extra_allocs_per_frame\":%.2f}\n",
+                cols, rows, cols * rows, procCount, workers, cols * rows >= kParallelMinCells ? "true" : "false",
+                serial.nsPerFrame, parallel.nsPerFrame,
+                serial.nsPerFrame / parallel.nsPerFrame, parallel.allocsPerFrame - serial.allocsPerFrame);
+}
+
+int main(int argc, char **argv)
+{
+    std::wstring themesDir;
+    {
+        std::string d = WINBTOP_BENCH_THEMES;
+        themesDir.assign(d.begin(), d.end());
+    }
+    std::wstring onlyTheme;
+    int frames = 20;
+    size_t onlyProcs = 0;
+    std::wstring colors = L"truecolor";
+    int workers = std::clamp((int)std::thread::hardware_concurrency() - 1, 1, 3);
+
+    for (int i = 1; i < argc; ++i)
+    {
+        auto arg = [&](const char *name)
+        { return std::strcmp(argv[i], name) == 0 && i + 1 < argc; };
+        if (arg("--themes"))
+        {
+            std::string d = argv[++i];
+            themesDir.assign(d.begin(), d.end());
+        }
+        else if (arg("--theme"))
+        {
+            std::string t = argv[++i];
+            onlyTheme.assign(t.begin(), t.end());
+        }
+        else if (arg("--frames"))
+            frames = std::max(1, std::atoi(argv[++i]));
+        else if (arg("--procs"))
+            onlyProcs = (size_t)std::strtoull(argv[++i], nullptr, 10);
+        else if (arg("--workers"))
+            workers = std::max(1, std::atoi(argv[++i]));
+        else if (arg("--colors"))
+        {
+            std::string c = argv[++i];
+            colors.assign(c.begin(), c.end());
+        }
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--themes DIR] [--theme NAME] [--frames N] [--procs N]"
+                                 " [--colors truecolor|256|16] [--workers N]\n",
+                         argv[0]);
+            return 2;
+        }
+    }
+
+    ColorDepth depth;
+    if (!ParseColorDepth(colors, depth))
+    {
+        std::fprintf(stderr, "unknown colour depth %ls\n", colors.c_str());
+        return 2;
+    }
+    SetColorDepth(depth);
+
+    ThemeManager themes;
+    if (!themes.LoadDir(themesDir))
+    {
+        std::fprintf(stderr, "no themes found in %ls\n", themesDir.c_str());
+        return 1;
+    }
+
+    static const struct
+    {
+        short cols, rows;
+    } layouts[] = {{5, 24}, {80, 24}, {120, 40}, {200, 60}, {320, 90}, {420, 150}};
+    static const size_t procCounts[] = {100, 1000, 10000, 50000};
+    static const Scenario scenarios[] = {Scenario::Idle, Scenario::Sample, Scenario::Menu, Scenario::Help,
+                                         Scenario::Scroll};
+
+    BenchSpark(frames * 1000);
+
+    for (const std::wstring &name : themes.Names())
+    {
+        if (!onlyTheme.empty() && name != onlyTheme)
+            continue;
+        themes.SetByName(name);
+        for (const auto &ly : layouts)
+            for (size_t n : procCounts)
+            {
+                if (onlyProcs && n != onlyProcs)
+                    continue;
+                for (Scenario sc : scenarios)
+                {
+                    const Result r = RunCase(ly.cols, ly.rows, n, sc, frames);
+                    std::printf("{\"bench\":\"frame\",\"theme\":\"%ls\",\"colors\":\"%ls\",\"cols\":%d,\"rows\":%d,\"procs\":%zu,"
+                                "\"scenario\":\"%s\",\"frames\":%d,\"ns_per_frame\":%.0f,"
+                                "\"bytes_per_frame\":%.1f,\"allocs_per_frame\":%.2f}\n",
+                                name.c_str(), colors.c_str(), ly.cols, ly.rows, n, ScenarioName(sc), frames,
+                                r.nsPerFrame, r.bytesPerFrame, r.allocsPerFrame);
+                }
+            }
+    }
+
+    for (const auto &ly : layouts)
+        for (size_t n : procCounts)
+            if (!onlyProcs || n == onlyProcs)
+                BenchParallel(ly.cols, ly.rows, n, workers, frames);
+    return 0;
+}
@@ -1,8 +1,10 @@
 #include <windows.h>
+#include <winreg.h>
 #include <vector>
 #include <chrono>
 #include <thread>
 #include <cstdlib>
+#include <cwchar>
 #include <sstream>
 #include <algorithm>
 
@@ -14,10 +16,61 @@
 #include "pdh_metrics.h"
 #include "theme.h"
 #include "settings.h"
+#include "fmt.h"
+#include "host_info.h"
+#include "frame_writer.h"
 
 static Sampler *gSampler = nullptr;
 static ThemeManager gThemes;
 
+// Token bucket for Settings::maxBytesPerSec. Frames that only show a new
+// sample wait until the bucket is positive again; input still redraws at
+// once, but its bytes count against the budget too.
+struct OutputBudget
+{
+    double rate = 0; // bytes per second, 0 = unlimited
+    double tokens = 0;
+    ULONGLONG last = 0;
+
+    void Refill(ULONGLONG now)
+    {
+        if (rate <= 0)
+            return;
+        tokens = std::min(rate, tokens + rate * (double)(now - last) / 1000.0);
+        last = now;
+    }
+    bool Ready() const { return rate <= 0 || tokens > 0; }
+    DWORD WaitMs() const { return Ready() ? INFINITE : (DWORD)(-tokens * 1000.0 / rate) + 1; }
+    void Spend(size_t bytes)
+    {
+        if (rate > 0)
+            tokens -= (double)bytes;
+    }
+};
+
+// The title only carries uptime to the hour, so it is rebuilt and pushed to
+// the console once an hour at most.
+static void UpdateTitle()
+{
+    static ULONGLONG shownHours = ~0ull;
+    const ULONGLONG hours = GetTickCount64() / (1000ull * 60 * 60);
+    if (hours == shownHours)
+        return;
+    shownHours = hours;
+    const int days = (int)(hours / 24);
+    const int hrs = (int)(hours % 24);
+
+    std::wstring title = L"winbtop — ";
+    WStrOut t{title};
+    FmtText(t, Host().cpuModel);
+    FmtText(t, L" — Uptime: ");
+    FmtUInt(t, (uint64_t)days);
+    FmtText(t, L"d ");
+    FmtUInt(t, (uint64_t)hrs);
+    FmtText(t, L"h  — Q quit · F1 cpu% · F2 mem · F3 pid · F6 name · F5 Hz · Esc menu · H help");
+    SetTitle(title);
+}
+
 static bool DebounceKey(DWORD vk, DWORD minMs = 180)
 {
     struct Slot
@@ -248,7 +301,6 @@ static void HandleInput(AppState &state,
                 static int rateIdx = 1;
                 const int rates[] = {2, 5, 10, 20};
                 rateIdx = (rateIdx + 1) % (int)(sizeof(rates) / sizeof(rates[0]));
-                std::scoped_lock lk(state.m);
                 state.hz = rates[rateIdx];
                 uiDirty = true;
                 break;
@@ -347,6 +399,14 @@ int wmain()
     Settings cfg;
     LoadSettings(cfg);
 
+    // WINBTOP_COLORS overrides the saved depth for this session only.
+    ColorDepth depth = ColorDepth::TrueColor;
+    wchar_t colorsEnv[16];
+    DWORD colorsLen = GetEnvironmentVariableW(L"WINBTOP_COLORS", colorsEnv, 16);
+    if (!(colorsLen > 0 && colorsLen < 16 && ParseColorDepth(colorsEnv, depth)))
+        ParseColorDepth(cfg.colors, depth);
+    SetColorDepth(depth);
+
     const std::wstring themesDir = ResolveThemesDir();
     if (!gThemes.LoadDir(themesDir))
     {
@@ -368,148 +428,212 @@ int wmain()
     std::atexit(+[]
                 { ShutdownConsole(); });
 
+    LoadHostInfo();
+
     AppState state;
     if (cfg.hz > 0)
         state.hz = cfg.hz;
 
-    Sampler sampler(state);
+    HANDLE sampleEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    Sampler sampler(state, [sampleEvent]
+                    { SetEvent(sampleEvent); });
     gSampler = &sampler;
     sampler.start();
 
     bool running = true;
 
     UiMode prevUi = UiMode::Normal;
-    ULONGLONG lastModalBaseRedraw = 0;
-    std::wstring lastThemeName = gThemes.Current().name;
+
+    Screen screen;
+    std::string frameOut;
+    FrameWriter writer;
+    writer.start();
+
+    wchar_t statsEnv[8];
+    DWORD statsLen = GetEnvironmentVariableW(L"WINBTOP_STATS", statsEnv, 8);
+    const bool showStats = statsLen > 0 && statsLen < 8 && statsEnv[0] != L'0';
+    RowCacheStats lastRowStats;
+
+    // WINBTOP_RENDER_WORKERS=N draws the panels on N extra threads on large
+    // consoles. Off by default until it has been measured against serial
+    // drawing on a multi-core machine.
+    wchar_t workersEnv[8];
+    DWORD workersLen = GetEnvironmentVariableW(L"WINBTOP_RENDER_WORKERS", workersEnv, 8);
+    if (workersLen > 0 && workersLen < 8)
+        SetParallelRender(std::clamp((int)std::wcstol(workersEnv, nullptr, 10), 0, 8), kParallelMinCells);
 
     auto draw_base = [&](const Layout &L,
                          double cpuUsage,
                          const MemInfo &mem,
                          const std::vector<ProcInfo> &procs,
+                         unsigned long long generation,
                          int hz,
                          const std::vector<double> &perCore,
                          const std::wstring &netLine,
                          const std::wstring &diskLine,
                          const std::wstring &netSpark,
                          const std::wstring &diskSpark,
+                         const Ring<double> &cpuHist,
+                         const Ring<double> &memHist,
                          int procSort,
                          int procScroll,
-                         int selectedIndex,
-                         int totalCount)
+                         int selectedIndex)
     {
-        std::wstring frame = BuildFrame(
-            L, cpuUsage, mem, procs, hz, perCore,
-            netLine, diskLine, netSpark, diskSpark,
-            procSort, procScroll, selectedIndex, totalCount);
-
-        HANDLE hout = GetStdHandle(STD_OUTPUT_HANDLE);
-        MoveCursor(1, 1);
-        DWORD w;
-        WriteConsoleW(hout, frame.c_str(), (DWORD)frame.size(), &w, nullptr);
+        UpdateTitle();
+        BuildFrame(
+            screen.Back(), L, cpuUsage, mem, procs, generation, hz, perCore,
+            netLine, diskLine, netSpark, diskSpark, cpuHist, memHist,
+            procSort, procScroll, selectedIndex);
     };
 
-    constexpr int UI_FPS = 60;
-    const auto uiFrameDur = std::chrono::duration<double>(1.0 / UI_FPS);
+    // The loop sleeps until there is input or the sampler has published a
+    // new snapshot; a frame is only built when one of them changed something.
+    HANDLE hIn = GetStdHandle(STD_INPUT_HANDLE);
+    const HANDLE waits[] = {hIn, sampleEvent};
+    unsigned long long drawnGeneration = ~0ull;
+    bool firstFrame = true;
+
+    OutputBudget budget;
+    budget.rate = (double)cfg.maxBytesPerSec;
+    budget.tokens = budget.rate;
+    budget.last = GetTickCount64();
+    bool deferred = false;
+    unsigned long long deferredFrames = 0;
+
+    // Only rebuilt when the console reports a new buffer size.
+    Layout L;
+    bool layoutStale = true;
 
     while (running)
     {
-        auto start = std::chrono::steady_clock::now();
+        if (!firstFrame)
+            WaitForMultipleObjects(2, waits, FALSE, deferred ? budget.WaitMs() : INFINITE);
+        firstFrame = false;
+        deferred = false;
+        budget.Refill(GetTickCount64());
 
-        Layout L = ComputeLayout();
-        auto tm = ComputeTableMetrics(L);
-        const int pageRows = tm.pageRows;
-
-        int procCount = 0;
+        if (layoutStale)
         {
-            std::scoped_lock lk(state.m);
-            procCount = (int)state.procs.size();
+            const COORD size = GetConsoleSize();
+            L = ComputeLayout(size.X, size.Y);
+            layoutStale = false;
         }
 
+        // Held until the next iteration; the sampler publishes a new one
+        // instead of touching this.
+        const std::shared_ptr<const Snapshot> snap = state.Current();
+        const int procCount = (int)snap->procs.size();
+
         bool themeChangedInPicker = false;
         bool resized = false;
         bool uiDirty = false;
-        HandleInput(state, pageRows, procCount, running, themeChangedInPicker, resized, uiDirty);
-
-        bool needBase = uiDirty || resized || (state.ui == UiMode::Normal);
-        ULONGLONG nowTick = GetTickCount64();
+        // Drain everything queued so a burst of wheel or key events ends in
+        // a single redraw.
+        for (int burst = 0; burst < 16 && running; ++burst)
+        {
+            HandleInput(state, L.table.pageRows, procCount, running, themeChangedInPicker, resized, uiDirty);
+            if (WaitForSingleObject(hIn, 0) != WAIT_OBJECT_0)
+                break;
+        }
+        if (!running)
+            break;
 
-        if (state.ui != UiMode::Normal)
+        if (resized)
         {
-            if (themeChangedInPicker)
-                needBase = true;
-            else if (nowTick - lastModalBaseRedraw >= 500)
-                needBase = true;
+            const COORD size = GetConsoleSize();
+            L = ComputeLayout(size.X, size.Y);
         }
-        if (prevUi != state.ui)
-            needBase = true;
+        if (screen.Resize(L.cols, L.rows))
+            resized = true;
 
-        double cpuUsage = 0.0;
-        MemInfo mem{};
-        std::vector<ProcInfo> procs;
-        std::vector<double> perCore;
-        std::wstring diskLine, netLine;
-        std::wstring diskSpark, netSpark;
+        const bool newSample = snap->generation != drawnGeneration;
+        // Overlays sit on their own layer, so the panels underneath keep
+        // updating while one is open.
+        const bool needFrame = uiDirty || resized || newSample || themeChangedInPicker || prevUi != state.ui;
+        if (!needFrame)
+            continue;
 
-        if (needBase)
+        // Over budget: skip frames that only carry a new sample; the wait
+        // above wakes up again once the bucket has refilled.
+        if (!budget.Ready() && !uiDirty && !resized && prevUi == state.ui)
         {
-            {
-                std::scoped_lock lk(state.m);
-                cpuUsage = state.cpuTotal;
-                mem = state.mem;
-                perCore = state.cpuCores;
-                procs = state.procs;
-
-                diskSpark = spark_braille(state.diskR_Hist.data(), 24);
-                netSpark = spark_braille(state.netUp_Hist.data(), 24);
-            }
-            diskLine = PdhSampleDiskLine();
-            netLine = PdhSampleNetLine();
+            deferred = true;
+            ++deferredFrames;
+            continue;
+        }
 
-            draw_base(L, cpuUsage, mem, procs, state.hz, perCore,
-                      netLine, diskLine, netSpark, diskSpark,
-                      state.procSort, state.procScroll, state.procIndex, (int)procs.size());
+        const std::wstring diskSpark = spark_braille(snap->diskR_Hist.data(), 24);
+        const std::wstring netSpark = spark_braille(snap->netUp_Hist.data(), 24);
+        drawnGeneration = snap->generation;
 
-            if (state.ui != UiMode::Normal)
-                lastModalBaseRedraw = nowTick;
-        }
+        const Telemetry tm = state.telemetry.Load();
 
-        HANDLE hout = GetStdHandle(STD_OUTPUT_HANDLE);
-        DWORD w;
+        draw_base(L, tm.cpuTotal, tm.mem, snap->procs, snap->generation, state.hz, snap->cpuCores,
+                  snap->netLine, snap->diskLine, netSpark, diskSpark, snap->cpuHist, snap->memHist,
+                  state.procSort, state.procScroll, state.procIndex);
+        ComposeFrame(screen.Back(), L, state, gThemes.Current().name);
 
-        if (state.ui == UiMode::MainMenu)
+        if (showStats)
         {
-            std::wstring overlay = BuildOverlayMainMenu(L, state);
-            WriteConsoleW(hout, overlay.c_str(), (DWORD)overlay.size(), &w, nullptr);
-        }
-        else if (state.ui == UiMode::ThemePicker)
-        {
-            std::wstring cur = gThemes.Current().name;
-            if (cur != lastThemeName)
-                lastThemeName = cur;
-            std::wstring overlay = BuildOverlayThemePicker(L, cur);
-            WriteConsoleW(hout, overlay.c_str(), (DWORD)overlay.size(), &w, nullptr);
+            const RowCacheStats rc = GetRowCacheStats();
+            std::wstring text;
+            WStrOut o{text};
+            FmtText(o, L" rows hit ");
+            FmtUInt(o, rc.hits - lastRowStats.hits);
+            FmtText(o, L" miss ");
+            FmtUInt(o, rc.misses - lastRowStats.misses);
+            if (budget.rate > 0)
+            {
+                FmtText(o, L"  deferred ");
+                FmtUInt(o, deferredFrames);
+            }
+            FmtText(o, L"  last frame ");
+            FmtUInt(o, screen.LastFrameBytes());
+            FmtText(o, L" B in ");
+            FmtUInt(o, writer.LastWrites());
+            FmtText(o, SyncOutputEnabled() ? L" sync write(s)  dropped " : L" write(s)  dropped ");
+            FmtUInt(o, writer.Dropped());
+            FmtText(o, L"  latency ");
+            FmtUInt(o, writer.LastLatencyUs() / 1000);
+            FmtText(o, L"/");
+            FmtUInt(o, writer.MaxLatencyUs() / 1000);
+            FmtText(o, L" ms  strings ");
+            FmtUInt(o, Strings().Size());
+            if (const uint64_t full = Strings().Failed())
+            {
+                FmtText(o, L" (");
+                FmtUInt(o, full);
+                FmtText(o, L" dropped, pool full)");
+            }
+            FmtText(o, L" ");
+            DrawFrameStats(screen.Back(), L, text);
+            lastRowStats = rc;
         }
-        else if (state.ui == UiMode::Help)
+
+        // A frame the writer has not started on is stale now; take it back
+        // and diff against what the terminal really shows.
+        if (writer.Retract())
+            screen.Rollback();
+        frameOut.clear();
+        BeginFrame(frameOut);
+        screen.Present(frameOut);
+        if (EndFrame(frameOut))
         {
-            std::wstring overlay = BuildOverlayHelp(L);
-            WriteConsoleW(hout, overlay.c_str(), (DWORD)overlay.size(), &w, nullptr);
+            budget.Spend(frameOut.size());
+            writer.Post(frameOut);
         }
 
         prevUi = state.ui;
-
-        auto elapsed = std::chrono::steady_clock::now() - start;
-        if (elapsed < uiFrameDur)
-            std::this_thread::sleep_for(uiFrameDur - elapsed);
     }
 
-    Settings outCfg;
+    writer.stop();
+
+    Settings outCfg = cfg;
     outCfg.themeName = gThemes.Current().name;
-    {
-        std::scoped_lock lk(state.m);
-        outCfg.hz = state.hz;
-    }
+    outCfg.hz = state.hz;
     SaveSettings(outCfg);
 
     sampler.stop();
+    CloseHandle(sampleEvent);
     return 0;
 }
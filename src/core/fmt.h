@@ -0,0 +1,253 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <string_view>
+
+// Append-only formatting for the render path: no streams, no locale and no
+// temporary strings. `Out` is anything with Put(char32_t) - a Pen writing
+// straight into the cell grid, Utf8Out for terminal bytes, or WStrOut for
+// callers that need a wide string.
+
+struct Utf8Out
+{
+    std::string &s;
+    void Put(char32_t c)
+    {
+        if (c < 0x80)
+            s.push_back((char)c);
+        else if (c < 0x800)
+        {
+            s.push_back((char)(0xC0 | (c >> 6)));
+            s.push_back((char)(0x80 | (c & 0x3F)));
+        }
+        else if (c < 0x10000)
+        {
+            s.push_back((char)(0xE0 | (c >> 12)));
+            s.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+            s.push_back((char)(0x80 | (c & 0x3F)));
+        }
+        else
+        {
+            s.push_back((char)(0xF0 | (c >> 18)));
+            s.push_back((char)(0x80 | ((c >> 12) & 0x3F)));
+            s.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+            s.push_back((char)(0x80 | (c & 0x3F)));
+        }
+    }
+};
+
+struct WStrOut
+{
+    std::wstring &s;
+    void Put(char32_t c)
+    {
+        if constexpr (sizeof(wchar_t) == 2)
+        {
+            if (c > 0xFFFF)
+            {
+                c -= 0x10000;
+                s.push_back((wchar_t)(0xD800 + (c >> 10)));
+                s.push_back((wchar_t)(0xDC00 + (c & 0x3FF)));
+                return;
+            }
+        }
+        s.push_back((wchar_t)c);
+    }
+};
+
+// Fixed-capacity scratch used where a field has to be measured before it is
+// padded; lives on the stack.
+struct FmtBuf
+{
+    char32_t data[48];
+    int n = 0;
+    void Put(char32_t c)
+    {
+        if (n < (int)(sizeof(data) / sizeof(data[0])))
+            data[n++] = c;
+    }
+};
+
+// Short ASCII field (a number, a unit) stored inline in a struct, so
+// formatted figures can be kept and copied without allocating.
+template <int N>
+struct FmtAscii
+{
+    char data[N];
+    uint8_t n = 0;
+    void Put(char32_t c)
+    {
+        if (n < N)
+            data[n++] = (char)c;
+    }
+    void Clear() { n = 0; }
+    int Size() const { return n; }
+
+    bool operator==(const FmtAscii &o) const
+    {
+        return n == o.n && std::char_traits<char>::compare(data, o.data, n) == 0;
+    }
+};
+
+template <class Out>
+inline void FmtRepeat(Out &o, char32_t c, int count)
+{
+    for (int i = 0; i < count; ++i)
+        o.Put(c);
+}
+
+// Writes `s` decoding UTF-16 surrogate pairs; at most `maxUnits` code units.
+template <class Out>
+inline void FmtText(Out &o, std::wstring_view s, size_t maxUnits = std::wstring_view::npos)
+{
+    const size_t end = s.size() < maxUnits ? s.size() : maxUnits;
+    for (size_t i = 0; i < end; ++i)
+    {
+        char32_t c = (char32_t)s[i];
+        if (sizeof(wchar_t) == 2 && c >= 0xD800 && c <= 0xDBFF && i + 1 < s.size())
+            c = 0x10000 + ((c - 0xD800) << 10) + ((char32_t)s[++i] - 0xDC00);
+        o.Put(c);
+    }
+}
+
+// Right-aligned unsigned integer in a field of `width` cells.
+template <class Out>
+inline void FmtUInt(Out &o, uint64_t v, int width = 0)
+{
+    char32_t digits[20];
+    int n = 0;
+    do
+    {
+        digits[n++] = (char32_t)(U'0' + v % 10);
+        v /= 10;
+    } while (v);
+    FmtRepeat(o, U' ', width - n);
+    while (n)
+        o.Put(digits[--n]);
+}
+
+// Right-aligned fixed-point value with `decimals` digits after the point,
+// rounded half away from zero like printf's %.Nf on these magnitudes.
+template <class Out>
+inline void FmtFixed(Out &o, double v, int decimals, int width = 0)
+{
+    static constexpr uint64_t kPow10[] = {1, 10, 100, 1000, 10000};
+    if (!std::isfinite(v))
+        v = 0.0;
+    if (decimals < 0)
+        decimals = 0;
+    if (decimals > 4)
+        decimals = 4;
+
+    const bool neg = v < 0;
+    const uint64_t scaled = (uint64_t)std::llround((neg ? -v : v) * (double)kPow10[decimals]);
+    const uint64_t whole = scaled / kPow10[decimals];
+    uint64_t frac = scaled % kPow10[decimals];
+
+    FmtBuf b;
+    if (neg && scaled)
+        b.Put(U'-');
+    FmtUInt(b, whole);
+    if (decimals)
+    {
+        b.Put(U'.');
+        for (uint64_t div = kPow10[decimals] / 10; div; div /= 10)
+        {
+            b.Put((char32_t)(U'0' + frac / div));
+            frac %= div;
+        }
+    }
+    FmtRepeat(o, U' ', width - b.n);
+    for (int i = 0; i < b.n; ++i)
+        o.Put(b.data[i]);
+}
+
+// Human-readable byte count ("12.3 MiB"): 2 decimals below 10, 1 below 100,
+// none above. Left-aligned and padded to `width` when one is given.
+template <class Out>
+inline void FmtBytes(Out &o, uint64_t bytes, int width = 0)
+{
+    static const char32_t *const units[] = {U"B", U"KiB", U"MiB", U"GiB", U"TiB"};
+    int u = 0;
+    long double val = (long double)bytes;
+    while (val >= 1024.0 && u < 4)
+    {
+        val /= 1024.0;
+        ++u;
+    }
+    FmtBuf b;
+    FmtFixed(b, (double)val, val >= 100 ? 0 : (val >= 10 ? 1 : 2));
+    b.Put(U' ');
+    for (const char32_t *p = units[u]; *p; ++p)
+        b.Put(*p);
+
+    const int n = (width > 0 && b.n > width) ? width : b.n;
+    for (int i = 0; i < n; ++i)
+        o.Put(b.data[i]);
+    FmtRepeat(o, U' ', width - n);
+}
+
+// `s` cut or space-padded to exactly `width` code units.
+template <class Out>
+inline void FmtPad(Out &o, std::wstring_view s, int width)
+{
+    if (width <= 0)
+        return;
+    FmtText(o, s, (size_t)width);
+    FmtRepeat(o, U' ', width - (int)s.size());
+}
+
+// Copies a kept field; right-aligned in `width` cells when `right`, else
+// left-aligned and cut to `width`.
+template <class Out, int N>
+inline void FmtField(Out &o, const FmtAscii<N> &s, int width, bool right)
+{
+    const int n = (width > 0 && s.n > width) ? width : s.n;
+    if (right)
+        FmtRepeat(o, U' ', width - n);
+    for (int i = 0; i < n; ++i)
+        o.Put((char32_t)s.data[i]);
+    if (!right)
+        FmtRepeat(o, U' ', width - n);
+}
+
+// Like FmtPad, but an overlong `s` ends in an ellipsis.
+template <class Out>
+inline void FmtEllipsis(Out &o, std::wstring_view s, int width)
+{
+    if (width <= 0)
+        return;
+    if ((int)s.size() <= width || width == 1)
+        return FmtPad(o, s, width);
+    FmtText(o, s, (size_t)width - 1);
+    o.Put(U'…');
+}
+
+// Like FmtEllipsis, but keeps both ends of `s` and elides the middle.
+template <class Out>
+inline void FmtMiddleEllipsis(Out &o, std::wstring_view s, int width)
+{
+    if (width <= 0)
+        return;
+    if ((int)s.size() <= width || width == 1)
+        return FmtPad(o, s, width);
+    // Neither cut may fall inside a surrogate pair: the left end gives a
+    // split pair's unit to the right end, and the right end drops its
+    // orphaned low half for a space.
+    auto low = [&](size_t i) { return sizeof(wchar_t) == 2 && s[i] >= 0xDC00 && s[i] <= 0xDFFF; };
+    size_t left = (size_t)(width - 1) / 2;
+    size_t right = (size_t)(width - 1) - left;
+    if (left > 0 && low(left))
+    {
+        --left;
+        ++right;
+    }
+    size_t from = s.size() - right;
+    const int pad = low(from) ? 1 : 0;
+    from += pad;
+    FmtText(o, s, left);
+    o.Put(U'…');
+    FmtText(o, s.substr(from));
+    FmtRepeat(o, U' ', pad);
+}
@@ -0,0 +1,83 @@
+#include "frame_writer.h"
+#include "util.h"
+
+void FrameWriter::start()
+{
+    if (th.joinable())
+        return;
+    quit = false;
+    th = std::thread(&FrameWriter::run, this);
+}
+
+void FrameWriter::stop()
+{
+    {
+        std::scoped_lock lk(m);
+        quit = true;
+    }
+    cv.notify_one();
+    if (th.joinable())
+        th.join();
+}
+
+void FrameWriter::Post(std::string &frame)
+{
+    {
+        std::scoped_lock lk(m);
+        // Without a Retract() first, `frame` is a diff on top of the waiting
+        // one, so both have to go out.
+        if (pending)
+            slot += frame;
+        else
+        {
+            slot.swap(frame);
+            postedAt = std::chrono::steady_clock::now();
+        }
+        pending = true;
+    }
+    frame.clear();
+    cv.notify_one();
+}
+
+bool FrameWriter::Retract()
+{
+    std::scoped_lock lk(m);
+    if (!pending)
+        return false;
+    pending = false;
+    slot.clear();
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void FrameWriter::run()
+{
+    std::string out;
+    for (;;)
+    {
+        std::chrono::steady_clock::time_point t0;
+        {
+            std::unique_lock lk(m);
+            cv.wait(lk, [&]
+                    { return pending || quit; });
+            if (!pending)
+                return;
+            out.swap(slot);
+            pending = false;
+            t0 = postedAt;
+        }
+
+        const uint64_t calls0 = ConsoleWriteCalls();
+        WriteConsoleBytes(out);
+        out.clear();
+
+        const uint64_t us = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                                std::chrono::steady_clock::now() - t0)
+                                .count();
+        lastWrites.store(ConsoleWriteCalls() - calls0, std::memory_order_relaxed);
+        lastLatencyUs.store(us, std::memory_order_relaxed);
+        if (us > maxLatencyUs.load(std::memory_order_relaxed))
+            maxLatencyUs.store(us, std::memory_order_relaxed);
+        written.fetch_add(1, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Writes finished frames to the console on its own thread, so a terminal
+// that drains slowly never blocks input handling or composition. At most
+// one frame waits; the UI takes it back with Retract() before presenting a
+// newer one, so the newest frame always wins.
+class FrameWriter
+{
+public:
+    void start();
+    // Writes whatever is still waiting, then joins the thread.
+    void stop();
+
+    // Queues `frame`. The string is swapped with the writer's previous
+    // buffer, so `frame` comes back empty with capacity to reuse.
+    void Post(std::string &frame);
+    // Takes back a frame the thread has not started writing yet; it counts
+    // as dropped. The caller must roll its screen state back.
+    bool Retract();
+
+    uint64_t Written() const { return written.load(std::memory_order_relaxed); }
+    uint64_t Dropped() const { return dropped.load(std::memory_order_relaxed); }
+    // Microseconds from Post() until the write returned: last frame, worst.
+    uint64_t LastLatencyUs() const { return lastLatencyUs.load(std::memory_order_relaxed); }
+    uint64_t MaxLatencyUs() const { return maxLatencyUs.load(std::memory_order_relaxed); }
+    // WriteConsoleA calls the last frame needed.
+    uint64_t LastWrites() const { return lastWrites.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+
+    std::mutex m;
+    std::condition_variable cv;
+    std::string slot;
+    bool pending = false, quit = false;
+    std::chrono::steady_clock::time_point postedAt;
+
+    std::atomic<uint64_t> written{0}, dropped{0};
+    std::atomic<uint64_t> lastLatencyUs{0}, maxLatencyUs{0}, lastWrites{0};
+    std::thread th;
+};
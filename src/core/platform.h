@@ -0,0 +1,20 @@
+#pragma once
+
+// Win32 scalar types used by the data model. The render code only needs
+// these, so it can also be built (for benchmarks) where <windows.h> is not
+// available.
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cstddef>
+#include <cstdint>
+
+typedef uint32_t DWORD;
+typedef size_t SIZE_T;
+typedef unsigned long long ULONGLONG;
+
+struct COORD
+{
+    short X, Y;
+};
+#endif
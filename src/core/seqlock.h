@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+// Single-writer sequence lock for a small trivially copyable value. The
+// writer never waits; a reader that overlaps a Store() retries until it has
+// a copy no write touched. The value is kept as relaxed 64-bit atomics, so a
+// torn read is discarded rather than being a data race.
+template <typename T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable_v<T>, "SeqLock holds trivially copyable values only");
+
+public:
+    // Only ever called from one thread.
+    void Store(const T &v)
+    {
+        uint64_t w[kWords] = {};
+        std::memcpy(w, &v, sizeof(T));
+        const uint32_t s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (int i = 0; i < kWords; ++i)
+            words[i].store(w[i], std::memory_order_relaxed);
+        seq.store(s + 2, std::memory_order_release);
+    }
+
+    T Load() const
+    {
+        uint64_t w[kWords];
+        for (;;)
+        {
+            const uint32_t s = seq.load(std::memory_order_acquire);
+            if (s & 1)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            for (int i = 0; i < kWords; ++i)
+                w[i] = words[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq.load(std::memory_order_relaxed) == s)
+                break;
+        }
+        T v;
+        std::memcpy(&v, w, sizeof(T));
+        return v;
+    }
+
+    // Number of completed stores.
+    uint32_t Version() const { return seq.load(std::memory_order_acquire) / 2; }
+
+private:
+    static constexpr int kWords = (int)((sizeof(T) + 7) / 8);
+
+    std::atomic<uint32_t> seq{0};
+    std::atomic<uint64_t> words[kWords] = {};
+};
@@ -75,6 +75,18 @@ bool LoadSettings(Settings &s)
                 {
                 }
             }
+            else if (k == L"colors")
+                s.colors = v;
+            else if (k == L"max_bytes_per_sec")
+            {
+                try
+                {
+                    s.maxBytesPerSec = (unsigned)std::max(0, std::stoi(v));
+                }
+                catch (...)
+                {
+                }
+            }
         }
         pos = eol + 1;
     }
@@ -90,7 +102,11 @@ bool SaveSettings(const Settings &s)
 
     std::string line1 = "theme=" + ToUtf8(s.themeName) + "\n";
     std::string line2 = "hz=" + std::to_string(s.hz) + "\n";
+    std::string line3 = "colors=" + ToUtf8(s.colors) + "\n";
+    std::string line4 = "max_bytes_per_sec=" + std::to_string(s.maxBytesPerSec) + "\n";
     out.write(line1.data(), (std::streamsize)line1.size());
     out.write(line2.data(), (std::streamsize)line2.size());
+    out.write(line3.data(), (std::streamsize)line3.size());
+    out.write(line4.data(), (std::streamsize)line4.size());
     return true;
 }
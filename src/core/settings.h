@@ -5,6 +5,10 @@ struct Settings
 {
     std::wstring themeName;
     int hz = 5;
+    // Output colour depth: "truecolor", "256" or "16".
+    std::wstring colors = L"truecolor";
+    // Cap on bytes written to the terminal per second; 0 = unlimited.
+    unsigned maxBytesPerSec = 0;
 };
 
 bool LoadSettings(Settings &s);
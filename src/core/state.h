@@ -1,9 +1,11 @@
 #pragma once
+#include <atomic>
+#include <memory>
 #include <vector>
 #include <deque>
-#include <mutex>
 #include <string>
 #include "metrics.h"
+#include "seqlock.h"
 
 enum class UiMode
 {
@@ -23,14 +25,18 @@ public:
         if (buf_.size() == cap_)
             buf_.pop_front();
         buf_.push_back(v);
+        ++pushed_;
     }
     const std::deque<T> &data() const { return buf_; }
+    // Total number of push() calls, including values already dropped.
+    unsigned long long pushed() const { return pushed_; }
     size_t size() const { return buf_.size(); }
     bool empty() const { return buf_.empty(); }
 
 private:
     size_t cap_;
     std::deque<T> buf_;
+    unsigned long long pushed_ = 0;
 };
 
 struct DiskStat
@@ -45,13 +51,49 @@ struct NetStat
     double upBps = 0, downBps = 0;
 };
 
-struct AppState
+// The scalar figures of a sampler tick; the per-core loads they summarise
+// are in the Snapshot.
+struct Telemetry
 {
-    UiMode ui = UiMode::Normal;
-
-    std::vector<double> cpuCores;
+    double cpuTotal = 0.0;
     MemInfo mem{};
+};
+
+// The lists and histories of a sampler tick. Published whole and never modified
+// afterwards, so readers share it without copying or locking.
+struct Snapshot
+{
+    Snapshot() = default;
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+    ~Snapshot()
+    {
+        if (procs.empty())
+            return;
+        StringPool::Batch b(Strings());
+        for (const ProcInfo &p : procs)
+        {
+            b.Release(p.name);
+            b.Release(p.user);
+            b.Release(p.cmdline);
+        }
+    }
+
+    // Takes the references on procs' strings that the destructor drops, so
+    // they stay resolvable for as long as anyone holds the snapshot.
+    void HoldStrings()
+    {
+        StringPool::Batch b(Strings());
+        for (const ProcInfo &p : procs)
+        {
+            b.Retain(p.name);
+            b.Retain(p.user);
+            b.Retain(p.cmdline);
+        }
+    }
+
     std::vector<ProcInfo> procs;
+    std::vector<double> cpuCores;
 
     Ring<double> cpuHist{180};
     Ring<double> memHist{180};
@@ -61,15 +103,33 @@ struct AppState
     Ring<double> netUp_Hist{180};
     Ring<double> netDn_Hist{180};
 
-    double cpuTotal = 0.0;
+    std::wstring diskLine, netLine;
+
+    // Bumped by the sampler with every snapshot it publishes.
+    unsigned long long generation = 0;
+};
+
+struct AppState
+{
+    UiMode ui = UiMode::Normal;
+
+    // The newest snapshot. Replaced wholesale by the sampler; a reader keeps
+    // the one it loaded alive for as long as it holds the pointer.
+    std::shared_ptr<const Snapshot> Current() const { return snapshot.load(std::memory_order_acquire); }
+    void Publish(std::shared_ptr<const Snapshot> s) { snapshot.store(std::move(s), std::memory_order_release); }
+
+    // Stored by the sampler just before the matching snapshot.
+    SeqLock<Telemetry> telemetry;
 
     int menuIndex = 0;
 
-    int hz = 5;
+    // Set by the UI, read by the sampler every tick.
+    std::atomic<int> hz{5};
 
-    int procSort = 0;
+    std::atomic<int> procSort{0};
     int procScroll = 0;
     int procIndex = 0;
 
-    std::mutex m;
+private:
+    std::atomic<std::shared_ptr<const Snapshot>> snapshot{std::make_shared<const Snapshot>()};
 };
@@ -0,0 +1,149 @@
+#include "string_pool.h"
+
+static uint32_t SlotOf(StrId id) { return (uint32_t)id; }
+static uint32_t GenOf(StrId id) { return (uint32_t)(id >> 32); }
+static StrId MakeId(uint32_t slot, uint32_t gen) { return ((StrId)gen << 32) | slot; }
+
+StringPool::StringPool() : chunks(new std::atomic<Entry *>[kMaxChunks])
+{
+    for (uint32_t i = 0; i < kMaxChunks; ++i)
+        chunks[i].store(nullptr, std::memory_order_relaxed);
+    // Slot 0 is the empty string behind kNoStr.
+    chunks[0].store(new Entry[kChunk], std::memory_order_release);
+    used = 1;
+}
+
+StringPool::~StringPool()
+{
+    for (uint32_t i = 0; i < kMaxChunks; ++i)
+        delete[] chunks[i].load(std::memory_order_relaxed);
+}
+
+StringPool::Entry &StringPool::At(uint32_t slot) const
+{
+    return chunks[slot >> kChunkBits].load(std::memory_order_acquire)[slot & (kChunk - 1)];
+}
+
+uint32_t StringPool::NewSlot()
+{
+    if (!freeSlots.empty())
+    {
+        const uint32_t slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+    if (used % kChunk == 0)
+    {
+        if (used / kChunk == kMaxChunks)
+        {
+            // Full: the longest idle string makes room.
+            if (idleHead == 0)
+                return 0;
+            const uint32_t slot = idleHead;
+            Evict(slot);
+            freeSlots.pop_back();
+            return slot;
+        }
+        chunks[used / kChunk].store(new Entry[kChunk], std::memory_order_release);
+    }
+    return used++;
+}
+
+void StringPool::Park(uint32_t slot)
+{
+    Entry &e = At(slot);
+    e.idlePrev = idleTail;
+    e.idleNext = 0;
+    if (idleTail)
+        At(idleTail).idleNext = slot;
+    else
+        idleHead = slot;
+    idleTail = slot;
+    if (++idleCount > kMaxIdle)
+        Evict(idleHead);
+}
+
+void StringPool::Unpark(uint32_t slot)
+{
+    Entry &e = At(slot);
+    if (e.idlePrev)
+        At(e.idlePrev).idleNext = e.idleNext;
+    else
+        idleHead = e.idleNext;
+    if (e.idleNext)
+        At(e.idleNext).idlePrev = e.idlePrev;
+    else
+        idleTail = e.idlePrev;
+    e.idlePrev = e.idleNext = 0;
+    --idleCount;
+}
+
+void StringPool::Evict(uint32_t slot)
+{
+    Unpark(slot);
+    Entry &e = At(slot);
+    index.erase(std::wstring_view(e.text));
+    std::wstring().swap(e.text);
+    ++e.gen;
+    freeSlots.push_back(slot);
+}
+
+StrId StringPool::Intern(std::wstring_view s)
+{
+    if (s.empty())
+        return kNoStr;
+    std::scoped_lock lk(m);
+    auto it = index.find(s);
+    if (it != index.end())
+    {
+        Entry &e = At(it->second);
+        if (e.refs++ == 0)
+            Unpark(it->second);
+        return MakeId(it->second, e.gen);
+    }
+    const uint32_t slot = NewSlot();
+    if (slot == 0)
+    {
+        failed.fetch_add(1, std::memory_order_relaxed);
+        return kNoStr;
+    }
+    Entry &e = At(slot);
+    e.text.assign(s);
+    e.refs = 1;
+    index.emplace(std::wstring_view(e.text), slot);
+    return MakeId(slot, e.gen);
+}
+
+const std::wstring &StringPool::Get(StrId id) const
+{
+    return At(SlotOf(id)).text;
+}
+
+size_t StringPool::Size() const
+{
+    std::scoped_lock lk(m);
+    return index.size();
+}
+
+void StringPool::Batch::Retain(StrId id)
+{
+    if (id != kNoStr)
+        ++pool.At(SlotOf(id)).refs;
+}
+
+void StringPool::Batch::Release(StrId id)
+{
+    if (id == kNoStr)
+        return;
+    Entry &e = pool.At(SlotOf(id));
+    if (e.gen != GenOf(id) || e.refs == 0)
+        return;
+    if (--e.refs == 0)
+        pool.Park(SlotOf(id));
+}
+
+StringPool &Strings()
+{
+    static StringPool pool;
+    return pool;
+}
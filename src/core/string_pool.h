@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Slot index in the low half, the slot's reuse count in the high half, so
+// an id that outlived its string never equals the id of whatever took the
+// slot next. 0 is the empty string.
+using StrId = uint64_t;
+inline constexpr StrId kNoStr = 0;
+
+// Interned strings with reference counts. Equal strings share one id, so
+// copying or comparing them costs a word. Get() takes no lock; counts only
+// change under the pool's mutex, a batch at a time.
+//
+// A string that loses its last reference stays interned, idle, so a process
+// name that comes back soon keeps its id and costs no allocation. The
+// oldest idle strings are evicted once there are more than kMaxIdle of them,
+// or when a new string needs a slot and the pool is full.
+class StringPool
+{
+public:
+    StringPool();
+    ~StringPool();
+    StringPool(const StringPool &) = delete;
+    StringPool &operator=(const StringPool &) = delete;
+
+    // The id of `s`, with one reference taken for the caller. The empty
+    // string is kNoStr and is not counted. So is a new string when every
+    // slot (kMaxChunks * kChunk) is referenced; Failed() counts those.
+    StrId Intern(std::wstring_view s);
+
+    // The text of an id the caller holds a reference on, directly or
+    // through a snapshot that does.
+    const std::wstring &Get(StrId id) const;
+
+    // Number of distinct strings held, idle ones included.
+    size_t Size() const;
+    // Intern() calls that found the pool full.
+    uint64_t Failed() const { return failed.load(std::memory_order_relaxed); }
+
+    // Holds the pool lock over a run of reference changes. Releasing the
+    // last reference leaves the string idle.
+    class Batch
+    {
+    public:
+        explicit Batch(StringPool &pool) : pool(pool), lk(pool.m) {}
+        void Retain(StrId id);
+        void Release(StrId id);
+
+    private:
+        StringPool &pool;
+        std::scoped_lock<std::mutex> lk;
+    };
+
+private:
+    struct Entry
+    {
+        std::wstring text;
+        uint32_t refs = 0;
+        uint32_t gen = 0;
+        // Neighbours on the idle list, oldest first; 0 ends it.
+        uint32_t idlePrev = 0, idleNext = 0;
+    };
+    static constexpr uint32_t kChunkBits = 12;
+    static constexpr uint32_t kChunk = 1u << kChunkBits;
+    static constexpr uint32_t kMaxChunks = 1024;
+    static constexpr uint32_t kMaxIdle = 4096;
+
+    Entry &At(uint32_t index) const;
+    uint32_t NewSlot();
+    void Park(uint32_t slot);
+    void Unpark(uint32_t slot);
+    // Frees an idle slot for reuse.
+    void Evict(uint32_t slot);
+
+    // Entries never move once a chunk exists, so Get() only needs the chunk
+    // pointer, published before any id in it is handed out.
+    std::unique_ptr<std::atomic<Entry *>[]> chunks;
+    uint32_t used = 0;
+    std::vector<uint32_t> freeSlots;
+    std::unordered_map<std::wstring_view, uint32_t> index;
+    uint32_t idleHead = 0, idleTail = 0, idleCount = 0;
+    std::atomic<uint64_t> failed{0};
+    mutable std::mutex m;
+};
+
+// The pool the sampler interns process names, users and command lines in.
+StringPool &Strings();
@@ -1,9 +1,10 @@
 #include "theme.h"
-#include "util.h"
 
+#ifdef _WIN32
 #include <windows.h>
 #include <shlwapi.h>
 #pragma comment(lib, "Shlwapi.lib")
+#endif
 
 #include <filesystem>
 #include <fstream>
@@ -12,24 +13,156 @@
 #include <string>
 #include <vector>
 #include <cmath>
+#include <cwchar>
+#include <cstdio>
+#include <cstdlib>
 
 static Theme g_theme;
+static Palette g_palette = []
+{
+    Palette p;
+    p.Compile(g_theme);
+    return p;
+}();
 
 const Theme &ActiveTheme() { return g_theme; }
-void SetActiveTheme(const Theme &t) { g_theme = t; }
+const Palette &ActivePalette() { return g_palette; }
+
+void SetActiveTheme(const Theme &t)
+{
+    g_theme = t;
+    g_palette.Compile(t, g_palette.Depth());
+}
+
+void SetColorDepth(ColorDepth depth)
+{
+    if (depth != g_palette.Depth())
+        g_palette.Compile(g_theme, depth);
+}
+
+bool ParseColorDepth(std::wstring_view s, ColorDepth &out)
+{
+    if (s == L"truecolor" || s == L"24bit")
+        out = ColorDepth::TrueColor;
+    else if (s == L"256")
+        out = ColorDepth::Color256;
+    else if (s == L"16")
+        out = ColorDepth::Color16;
+    else
+        return false;
+    return true;
+}
+
+static int Dist2(const Rgb &a, const Rgb &b)
+{
+    const int dr = a.r - b.r, dg = a.g - b.g, db = a.b - b.b;
+    return 2 * dr * dr + 4 * dg * dg + 3 * db * db;
+}
+
+// Nearest xterm-256 entry: the 6x6x6 cube or the 24-step grey ramp.
+static int To256(const Rgb &c)
+{
+    static constexpr int levels[6] = {0, 95, 135, 175, 215, 255};
+    auto nearestLevel = [](int v)
+    {
+        int best = 0;
+        for (int i = 1; i < 6; ++i)
+            if (std::abs(levels[i] - v) < std::abs(levels[best] - v))
+                best = i;
+        return best;
+    };
+    const int r = nearestLevel(c.r), g = nearestLevel(c.g), b = nearestLevel(c.b);
+    const int cube = 16 + 36 * r + 6 * g + b;
+    const Rgb cubeRgb{levels[r], levels[g], levels[b]};
+
+    const int avg = (c.r + c.g + c.b) / 3;
+    const int grey = std::clamp((avg - 8 + 5) / 10, 0, 23);
+    const int gv = 8 + grey * 10;
+
+    return Dist2(c, {gv, gv, gv}) < Dist2(c, cubeRgb) ? 232 + grey : cube;
+}
+
+// Nearest of the 16 console colours, using the Windows "Campbell" defaults.
+static int To16(const Rgb &c)
+{
+    static const Rgb ansi[16] = {
+        {12, 12, 12}, {197, 15, 31}, {19, 161, 14}, {193, 156, 0},
+        {0, 55, 218}, {136, 23, 152}, {58, 150, 221}, {204, 204, 204},
+        {118, 118, 118}, {231, 72, 86}, {22, 198, 12}, {249, 241, 165},
+        {59, 120, 255}, {180, 0, 158}, {97, 214, 214}, {242, 242, 242}};
+    int best = 0;
+    for (int i = 1; i < 16; ++i)
+        if (Dist2(c, ansi[i]) < Dist2(c, ansi[best]))
+            best = i;
+    return best;
+}
+
+void Palette::Compile(const Theme &t, ColorDepth depth)
+{
+    const Rgb roles[(size_t)ColorRole::Count] = {
+        t.text, t.dim, t.hdr, t.panel, t.bg, t.overlay, t.accent,
+        t.sel_fg, t.sel_bg, t.meter_bg, t.frame, t.divider,
+        t.barLo, t.barHi, t.box_cpu, t.box_mem, t.box_proc,
+        {255, 210, 120}, {255, 120, 120}};
+
+    for (size_t i = 0; i < (size_t)ColorRole::Count; ++i)
+        colors_[i] = roles[i];
+    for (int i = 0; i < kGradientSteps; ++i)
+    {
+        double k = (double)i / (kGradientSteps - 1);
+        colors_[kGradientBase + i] = {
+            (int)std::round(t.barLo.r + (t.barHi.r - t.barLo.r) * k),
+            (int)std::round(t.barLo.g + (t.barHi.g - t.barLo.g) * k),
+            (int)std::round(t.barLo.b + (t.barHi.b - t.barLo.b) * k)};
+    }
 
-std::wstring col_ok() { return fg24(ActiveTheme().barLo); }
-std::wstring col_warn() { return fg24(255, 210, 120); }
-std::wstring col_crit() { return fg24(255, 120, 120); }
-std::wstring col_dim() { return fg24(ActiveTheme().dim); }
-std::wstring col_hdr() { return fg24(ActiveTheme().hdr); }
-std::wstring col_text() { return fg24(ActiveTheme().text); }
-std::wstring col_accent() { return fg24(ActiveTheme().accent); }
+    char buf[32];
+    for (size_t i = 0; i < kSize; ++i)
+    {
+        const Rgb &c = colors_[i];
+        switch (depth)
+        {
+        case ColorDepth::Color256:
+        {
+            const int n = To256(c);
+            snprintf(buf, sizeof(buf), "38;5;%d", n);
+            fg_[i] = buf;
+            snprintf(buf, sizeof(buf), "48;5;%d", n);
+            bg_[i] = buf;
+            break;
+        }
+        case ColorDepth::Color16:
+        {
+            const int n = To16(c);
+            snprintf(buf, sizeof(buf), "%d", n < 8 ? 30 + n : 90 + n - 8);
+            fg_[i] = buf;
+            snprintf(buf, sizeof(buf), "%d", n < 8 ? 40 + n : 100 + n - 8);
+            bg_[i] = buf;
+            break;
+        }
+        default:
+            snprintf(buf, sizeof(buf), "38;2;%d;%d;%d", c.r, c.g, c.b);
+            fg_[i] = buf;
+            snprintf(buf, sizeof(buf), "48;2;%d;%d;%d", c.r, c.g, c.b);
+            bg_[i] = buf;
+            break;
+        }
+    }
+    depth_ = depth;
+    ++generation_;
+}
 
-std::wstring col_box_cpu() { return fg24(ActiveTheme().box_cpu); }
-std::wstring col_box_mem() { return fg24(ActiveTheme().box_mem); }
-std::wstring col_box_proc() { return fg24(ActiveTheme().box_proc); }
+std::string_view Palette::FgParams(ColorIndex i) const
+{
+    return i == kColorDefault ? std::string_view("39") : std::string_view(fg_[i]);
+}
 
+std::string_view Palette::BgParams(ColorIndex i) const
+{
+    return i == kColorDefault ? std::string_view("49") : std::string_view(bg_[i]);
+}
+
+#ifdef _WIN32
 std::wstring ResolveThemesDir()
 {
     wchar_t envBuf[MAX_PATH];
@@ -52,6 +185,15 @@ std::wstring ResolveThemesDir()
 
     return L"themes";
 }
+#else
+std::wstring ResolveThemesDir()
+{
+    if (const char *env = std::getenv("WINBTOP_THEMES"))
+        if (std::filesystem::is_directory(env))
+            return std::filesystem::path(env).wstring();
+    return L"themes";
+}
+#endif
 
 static bool hexToRgb(const std::string &hexIn, Rgb &out)
 {
@@ -128,18 +270,12 @@ static void applyBtopKey(Theme &t, const std::string &key, const std::string &he
         t.barHi = c;
 }
 
-static Theme loadOneTheme(const std::wstring &wpath)
+static Theme loadOneTheme(const std::filesystem::path &path)
 {
     Theme tt;
-    size_t p = wpath.find_last_of(L"\\/");
-    size_t dot = wpath.find_last_of(L'.');
-    if (p == std::wstring::npos)
-        p = (size_t)-1;
-    if (dot == std::wstring::npos || dot < p)
-        dot = wpath.size();
-    tt.name = wpath.substr(p + 1, dot - (p + 1));
-
-    std::ifstream in(std::filesystem::path(wpath), std::ios::binary);
+    tt.name = path.stem().wstring();
+
+    std::ifstream in(path, std::ios::binary);
     if (!in)
         return tt;
 
@@ -216,24 +352,29 @@ static Theme loadOneTheme(const std::wstring &wpath)
     return tt;
 }
 
+// Matches the extension case-insensitively, as the *.theme search mask the
+// loader used to pass to FindFirstFileW did.
+static bool IsThemeFile(const std::filesystem::path &p)
+{
+    const std::wstring ext = p.extension().wstring();
+#ifdef _WIN32
+    return _wcsicmp(ext.c_str(), L".theme") == 0;
+#else
+    return wcscasecmp(ext.c_str(), L".theme") == 0;
+#endif
+}
+
 bool ThemeManager::LoadDir(const std::wstring &dir)
 {
     themes_.clear();
 
-    WIN32_FIND_DATAW fd{};
-    std::wstring mask = dir + L"\\*.theme";
-    HANDLE h = FindFirstFileW(mask.c_str(), &fd);
-    if (h == INVALID_HANDLE_VALUE)
-        return false;
-
-    do
+    std::error_code ec;
+    for (const auto &entry : std::filesystem::directory_iterator(std::filesystem::path(dir), ec))
     {
-        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+        if (!entry.is_regular_file(ec) || !IsThemeFile(entry.path()))
             continue;
-        Theme t = loadOneTheme(dir + L"\\" + fd.cFileName);
-        themes_.push_back(std::move(t));
-    } while (FindNextFileW(h, &fd));
-    FindClose(h);
+        themes_.push_back(loadOneTheme(entry.path()));
+    }
 
     if (themes_.empty())
         return false;
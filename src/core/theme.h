@@ -1,5 +1,7 @@
 #pragma once
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
 struct Rgb
@@ -50,25 +52,92 @@ private:
     size_t idx_ = 0;
 };
 
-std::wstring RST();
-std::wstring fg24(int r, int g, int b);
-std::wstring bg24(int r, int g, int b);
-inline std::wstring fg24(const Rgb &c) { return fg24(c.r, c.g, c.b); }
-inline std::wstring bg24(const Rgb &c) { return bg24(c.r, c.g, c.b); }
+// Colour slots the renderer draws with. Cells store a ColorIndex: a role,
+// a step of the barLo->barHi gradient, or kColorDefault.
+enum class ColorRole : uint8_t
+{
+    Text,
+    Dim,
+    Hdr,
+    Panel,
+    Bg,
+    Overlay,
+    Accent,
+    SelFg,
+    SelBg,
+    MeterBg,
+    Frame,
+    Divider,
+    BarLo,
+    BarHi,
+    BoxCpu,
+    BoxMem,
+    BoxProc,
+    Warn,
+    Crit,
+    Count
+};
+
+using ColorIndex = uint16_t;
+
+constexpr int kGradientSteps = 256;
+constexpr ColorIndex kGradientBase = (ColorIndex)ColorRole::Count;
+constexpr ColorIndex kColorDefault = 0xFFFF;
+
+constexpr ColorIndex ToIndex(ColorRole r) { return (ColorIndex)r; }
+
+// What the terminal is told to draw with. Lower depths send much shorter
+// SGR sequences, at the cost of snapping theme colours to a fixed palette.
+enum class ColorDepth : uint8_t
+{
+    TrueColor, // 38;2;r;g;b
+    Color256,  // 38;5;n  (xterm 6x6x6 cube + grey ramp)
+    Color16,   // 30-37 / 90-97
+};
+
+// "truecolor"/"24bit", "256", "16"; false for anything else.
+bool ParseColorDepth(std::wstring_view s, ColorDepth &out);
+
+// A theme compiled for rendering: every role and gradient step with its SGR
+// parameters pre-rendered for the output depth ("38;2;r;g;b", "38;5;n" or
+// "9n"), so the frame path only appends cached spans. Theme colours are
+// quantized here, once per activation.
+class Palette
+{
+public:
+    void Compile(const Theme &t, ColorDepth depth = ColorDepth::TrueColor);
+
+    const Rgb &Color(ColorIndex i) const { return colors_[i]; }
+    std::string_view FgParams(ColorIndex i) const;
+    std::string_view BgParams(ColorIndex i) const;
+
+    // Colour of cell `i` in a bar with `filled` gradient cells.
+    static ColorIndex Gradient(int i, int filled)
+    {
+        if (filled <= 1)
+            return (ColorIndex)(kGradientBase + kGradientSteps - 1);
+        return (ColorIndex)(kGradientBase + (i * (kGradientSteps - 1) + (filled - 1) / 2) / (filled - 1));
+    }
+
+    ColorDepth Depth() const { return depth_; }
+
+    // Bumped on every Compile(); cached output keyed by colour must check it.
+    unsigned Generation() const { return generation_; }
+
+private:
+    static constexpr size_t kSize = kGradientBase + kGradientSteps;
+
+    Rgb colors_[kSize];
+    std::string fg_[kSize];
+    std::string bg_[kSize];
+    ColorDepth depth_ = ColorDepth::TrueColor;
+    unsigned generation_ = 0;
+};
 
 const Theme &ActiveTheme();
+const Palette &ActivePalette();
 void SetActiveTheme(const Theme &t);
-
-std::wstring col_ok();
-std::wstring col_warn();
-std::wstring col_crit();
-std::wstring col_dim();
-std::wstring col_hdr();
-std::wstring col_text();
-std::wstring col_accent();
-
-std::wstring col_box_cpu();
-std::wstring col_box_mem();
-std::wstring col_box_proc();
+// Recompiles the active palette for a different output depth.
+void SetColorDepth(ColorDepth depth);
 
 std::wstring ResolveThemesDir();
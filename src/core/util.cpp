@@ -1,26 +1,25 @@
 #include "util.h"
+#include "fmt.h"
 
-#include <sstream>
-#include <iomanip>
 #include <io.h>
 #include <fcntl.h>
 #include <cwchar>
 #include <cstring>
+#include <atomic>
 
-std::wstring RST() { return L"\x1b[0m"; }
+static bool g_syncOutput = false;
+static std::atomic<uint64_t> g_writeCalls{0};
 
-std::wstring fg24(int r, int g, int b)
-{
-    wchar_t buf[64];
-    swprintf(buf, 64, L"\x1b[38;2;%d;%d;%dm", r, g, b);
-    return buf;
-}
+static constexpr std::string_view kSyncBegin = "\x1b[?2026h";
+static constexpr std::string_view kSyncEnd = "\x1b[?2026l";
 
-std::wstring bg24(int r, int g, int b)
+static bool DetectSyncOutput()
 {
-    wchar_t buf[64];
-    swprintf(buf, 64, L"\x1b[48;2;%d;%d;%dm", r, g, b);
-    return buf;
+    wchar_t v[8];
+    DWORD n = GetEnvironmentVariableW(L"WINBTOP_SYNC", v, 8);
+    if (n > 0 && n < 8)
+        return v[0] != L'0';
+    return GetEnvironmentVariableW(L"WT_SESSION", nullptr, 0) > 0;
 }
 
 bool InitConsole()
@@ -45,38 +44,66 @@ bool InitConsole()
     SetConsoleCP(CP_UTF8);
     _setmode(_fileno(stdout), _O_U8TEXT);
 
-    DWORD w;
-    const char *kEnterAlt = "\x1b[?1049h\x1b[?25l"; // alt screen + hide cursor
-    WriteConsoleA(hOut, kEnterAlt, (DWORD)std::strlen(kEnterAlt), &w, nullptr);
+    g_syncOutput = DetectSyncOutput();
+
+    WriteConsoleBytes("\x1b[?1049h\x1b[?25l"); // alt screen + hide cursor
     return true;
 }
 
 void ShutdownConsole()
 {
-    HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
-    DWORD w;
-    const char *kLeaveAlt = "\x1b[?25h\x1b[?1049l"; // show cursor + leave alt screen
-    WriteConsoleA(hOut, kLeaveAlt, (DWORD)std::strlen(kLeaveAlt), &w, nullptr);
+    WriteConsoleBytes("\x1b[?25h\x1b[?1049l"); // show cursor + leave alt screen
 }
 
 void ClearScreen()
 {
-    DWORD written;
-    HANDLE hout = GetStdHandle(STD_OUTPUT_HANDLE);
-    WriteConsoleA(hout, "\x1b[2J\x1b[H", 7, &written, nullptr);
+    WriteConsoleBytes("\x1b[2J\x1b[H");
 }
 
-void MoveCursor(short row, short col)
+void SetTitle(std::wstring_view title)
 {
-    char buf[32];
-    int n = snprintf(buf, sizeof(buf), "\x1b[%d;%dH", (int)row, (int)col);
-    DWORD w;
-    WriteConsoleA(GetStdHandle(STD_OUTPUT_HANDLE), buf, n, &w, nullptr);
+    SetConsoleTitleW(std::wstring(title).c_str());
 }
 
-void SetTitle(std::wstring_view title)
+void WriteConsoleBytes(std::string_view bytes)
 {
-    SetConsoleTitleW(std::wstring(title).c_str());
+    HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+    while (!bytes.empty())
+    {
+        DWORD w = 0;
+        g_writeCalls.fetch_add(1, std::memory_order_relaxed);
+        if (!WriteConsoleA(hOut, bytes.data(), (DWORD)bytes.size(), &w, nullptr) || w == 0)
+            return;
+        bytes.remove_prefix(w);
+    }
+}
+
+void BeginFrame(std::string &out)
+{
+    if (g_syncOutput)
+        out += kSyncBegin;
+}
+
+bool EndFrame(std::string &out)
+{
+    if (g_syncOutput)
+    {
+        if (out.size() == kSyncBegin.size())
+            out.clear();
+        else
+            out += kSyncEnd;
+    }
+    return !out.empty();
+}
+
+bool SyncOutputEnabled()
+{
+    return g_syncOutput;
+}
+
+uint64_t ConsoleWriteCalls()
+{
+    return g_writeCalls.load(std::memory_order_relaxed);
 }
 
 COORD GetConsoleSize()
@@ -90,24 +117,8 @@ COORD GetConsoleSize()
 
 std::wstring FormatBytesULONGLONG(ULONGLONG bytes)
 {
-    static const wchar_t *units[] = {L"B", L"KiB", L"MiB", L"GiB", L"TiB"};
-    int u = 0;
-    long double val = (long double)bytes;
-    while (val >= 1024.0 && u < 4)
-    {
-        val /= 1024.0;
-        ++u;
-    }
-    std::wstringstream ss;
-    ss << std::fixed << std::setprecision(val >= 100 ? 0 : (val >= 10 ? 1 : 2))
-       << val << L" " << units[u];
-    return ss.str();
-}
-
-std::wstring PadRight(std::wstring s, size_t width)
-{
-    if (s.size() >= width)
-        return s.substr(0, width);
-    s.append(width - s.size(), L' ');
+    std::wstring s;
+    WStrOut out{s};
+    FmtBytes(out, bytes);
     return s;
 }
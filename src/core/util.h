@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <string_view>
 #include <windows.h>
@@ -11,16 +12,25 @@
 #define ENABLE_QUICK_EDIT_MODE 0x0040
 #endif
 
-std::wstring RST();
-std::wstring fg24(int r, int g, int b);
-std::wstring bg24(int r, int g, int b);
-
 bool InitConsole();
 void ShutdownConsole();
 void ClearScreen();
-void MoveCursor(short row, short col);
 void SetTitle(std::wstring_view title);
+// Writes UTF-8 bytes to the console; one call unless the console takes
+// less than everything.
+void WriteConsoleBytes(std::string_view bytes);
+
+// A frame is assembled as BeginFrame(out), Screen::Present(out),
+// EndFrame(out) and reaches the console in a single write. With
+// synchronized output on, it is bracketed by CSI ?2026 h/l so the terminal
+// never shows it half drawn. EndFrame() returns false, leaving `out` empty,
+// when the frame changed nothing and need not be written.
+void BeginFrame(std::string &out);
+bool EndFrame(std::string &out);
+// On in Windows Terminal (WT_SESSION); WINBTOP_SYNC=0/1 overrides.
+bool SyncOutputEnabled();
+// WriteConsoleA calls since startup.
+uint64_t ConsoleWriteCalls();
 COORD GetConsoleSize();
 
 std::wstring FormatBytesULONGLONG(ULONGLONG bytes);
-std::wstring PadRight(std::wstring s, size_t width);
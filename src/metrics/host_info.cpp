@@ -0,0 +1,99 @@
+#include "host_info.h"
+#include <windows.h>
+#include <winreg.h>
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+static HostInfo g_host;
+
+const HostInfo &Host()
+{
+    return g_host;
+}
+
+static std::wstring RegString(const wchar_t *key, const wchar_t *value)
+{
+    wchar_t buf[256];
+    DWORD sz = sizeof(buf);
+    if (RegGetValueW(HKEY_LOCAL_MACHINE, key, value, RRF_RT_REG_SZ, nullptr, buf, &sz) != ERROR_SUCCESS)
+        return {};
+    return buf;
+}
+
+static DWORD RegDword(const wchar_t *key, const wchar_t *value)
+{
+    DWORD v = 0, sz = sizeof(v);
+    if (RegGetValueW(HKEY_LOCAL_MACHINE, key, value, RRF_RT_REG_DWORD, nullptr, &v, &sz) != ERROR_SUCCESS)
+        return 0;
+    return v;
+}
+
+// Counts cores and packages; falls back to one core per logical processor.
+static void LoadTopology(HostInfo &h)
+{
+    h.logicalCores = std::max<int>(1, (int)GetActiveProcessorCount(ALL_PROCESSOR_GROUPS));
+    h.physicalCores = h.logicalCores;
+
+    DWORD len = 0;
+    GetLogicalProcessorInformationEx(RelationAll, nullptr, &len);
+    if (GetLastError() != ERROR_INSUFFICIENT_BUFFER || len == 0)
+        return;
+    std::vector<BYTE> buf(len);
+    auto *info = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *>(buf.data());
+    if (!GetLogicalProcessorInformationEx(RelationAll, info, &len))
+        return;
+
+    int cores = 0, packages = 0, smtCores = 0;
+    for (DWORD off = 0; off < len;)
+    {
+        const auto *e = reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *>(buf.data() + off);
+        if (e->Relationship == RelationProcessorCore)
+        {
+            ++cores;
+            if (e->Processor.Flags & LTP_PC_SMT)
+                ++smtCores;
+        }
+        else if (e->Relationship == RelationProcessorPackage)
+            ++packages;
+        off += e->Size;
+    }
+    if (cores > 0)
+    {
+        h.physicalCores = cores;
+        h.threadsPerCore = smtCores ? std::max(1, h.logicalCores / cores) : 1;
+    }
+    if (packages > 0)
+        h.packages = packages;
+}
+
+void LoadHostInfo()
+{
+    HostInfo h;
+
+    std::wstring model = RegString(L"HARDWARE\\DESCRIPTION\\System\\CentralProcessor\\0", L"ProcessorNameString");
+    // Some vendors pad the brand string with spaces.
+    while (!model.empty() && model.back() == L' ')
+        model.pop_back();
+    if (!model.empty())
+        h.cpuModel = model.substr(model.find_first_not_of(L' '));
+
+    LoadTopology(h);
+
+    MEMORYSTATUSEX ms{};
+    ms.dwLength = sizeof(ms);
+    if (GlobalMemoryStatusEx(&ms))
+        h.totalMemory = ms.ullTotalPhys;
+
+    const wchar_t *cv = L"SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion";
+    h.osName = RegString(cv, L"ProductName");
+    h.osBuild = (DWORD)std::wcstoul(RegString(cv, L"CurrentBuildNumber").c_str(), nullptr, 10);
+    h.osRevision = RegDword(cv, L"UBR");
+    // Windows 11 still reports itself as "Windows 10" in ProductName.
+    if (h.osBuild >= 22000 && h.osName.compare(0, 10, L"Windows 10") == 0)
+        h.osName[9] = L'1';
+    if (h.osName.empty())
+        h.osName = L"Windows";
+
+    g_host = std::move(h);
+}
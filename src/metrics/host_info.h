@@ -0,0 +1,21 @@
+#pragma once
+#include "platform.h"
+#include <string>
+
+// Facts about the machine that do not change while winbtop runs. Filled once
+// by LoadHostInfo() before the sampler starts; read-only afterwards.
+struct HostInfo
+{
+    std::wstring cpuModel = L"CPU";
+    int logicalCores = 1;
+    int physicalCores = 1;
+    int packages = 1;
+    // Logical processors per physical core; 2 with SMT / Hyper-Threading.
+    int threadsPerCore = 1;
+    ULONGLONG totalMemory = 0;
+    std::wstring osName;
+    DWORD osBuild = 0, osRevision = 0;
+};
+
+void LoadHostInfo();
+const HostInfo &Host();
@@ -1,5 +1,7 @@
 #pragma once
-#include <windows.h>
+#include "platform.h"
+#include "fmt.h"
+#include "string_pool.h"
 #include <string>
 #include <vector>
 
@@ -14,17 +16,43 @@ struct MemInfo
     double percent = 0.0;
 };
 
+// How hot a process's CPU figure is drawn.
+enum class CpuLoad : uint8_t
+{
+    Low,
+    Warn,
+    Crit
+};
+
 struct ProcInfo
 {
     DWORD pid = 0;
-    std::wstring name;
-    std::wstring user;
-    std::wstring cmdline;
+    // Ids in Strings(). A ProcInfo holds no references itself; the snapshot
+    // it is published in does.
+    StrId name = kNoStr;
+    StrId user = kNoStr;
+    StrId cmdline = kNoStr;
     SIZE_T workingSet = 0;
     DWORD threads = 0;
     double cpu_percent = 0.0;
+
+    // Display figures, formatted by FormatProcText() once per sample.
+    FmtAscii<12> memText;
+    FmtAscii<8> cpuText;
+    CpuLoad load = CpuLoad::Low;
 };
 
+// Fills the width-independent display figures of `p` from its values.
+inline void FormatProcText(ProcInfo &p)
+{
+    p.memText.Clear();
+    FmtBytes(p.memText, (uint64_t)p.workingSet);
+    p.cpuText.Clear();
+    FmtFixed(p.cpuText, p.cpu_percent, 1);
+    p.load = p.cpu_percent > 80 ? CpuLoad::Crit : p.cpu_percent > 50 ? CpuLoad::Warn
+                                                                     : CpuLoad::Low;
+}
+
 bool GetSystemCpuTimes(CpuTimes &out);
 double CalcCpuUsage(const CpuTimes &prev, const CpuTimes &curr);
 
@@ -53,6 +53,7 @@ bool SnapshotProcesses(std::vector<ProcRaw> &out)
             FILETIME ct{}, et{}, kt{}, ut{};
             if (GetProcessTimes(h, &ct, &et, &kt, &ut))
             {
+                pr.createTime = FileTimeToULL(ct);
                 pr.kernel = FileTimeToULL(kt);
                 pr.user = FileTimeToULL(ut);
             }
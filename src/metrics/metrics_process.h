@@ -7,6 +7,9 @@ struct ProcRaw
 {
     DWORD pid = 0;
     DWORD ppid = 0;
+    // FILETIME ticks; 0 when the process could not be opened. With the pid
+    // it tells a recycled pid from the process that had it before.
+    ULONGLONG createTime = 0;
     ULONGLONG kernel = 0;
     ULONGLONG user = 0;
     SIZE_T workingSet = 0;
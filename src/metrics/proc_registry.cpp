@@ -0,0 +1,94 @@
+#include "proc_registry.h"
+
+#include <utility>
+
+static size_t HashKey(DWORD pid, ULONGLONG createTime)
+{
+    uint64_t h = createTime ^ ((uint64_t)pid * 0x9E3779B97F4A7C15ull);
+    h ^= h >> 32;
+    h *= 0xD6E8FEB86659FD93ull;
+    h ^= h >> 32;
+    return (size_t)h;
+}
+
+void ProcRegistry::BeginTick(size_t processes)
+{
+    ++epoch;
+    // Keep live, dead and new slots under three quarters of the table;
+    // a rehash leaves it at most half full.
+    if (slots.empty() || (live + dead + processes) * 4 > slots.size() * 3)
+    {
+        size_t capacity = 16;
+        while (capacity < (live + processes) * 2)
+            capacity *= 2;
+        Rehash(capacity);
+    }
+}
+
+void ProcRegistry::Rehash(size_t capacity)
+{
+    std::vector<Slot> old = std::move(slots);
+    slots.assign(capacity, Slot{});
+    const size_t mask = capacity - 1;
+    for (Slot &s : old)
+    {
+        if (s.state != SlotState::Live)
+            continue;
+        size_t i = HashKey(s.pid, s.createTime) & mask;
+        while (slots[i].state != SlotState::Empty)
+            i = (i + 1) & mask;
+        slots[i] = std::move(s);
+    }
+    dead = 0;
+}
+
+ProcRecord &ProcRegistry::Touch(DWORD pid, ULONGLONG createTime)
+{
+    const size_t mask = slots.size() - 1;
+    size_t i = HashKey(pid, createTime) & mask;
+    Slot *reuse = nullptr;
+    for (;; i = (i + 1) & mask)
+    {
+        Slot &s = slots[i];
+        if (s.state == SlotState::Empty)
+            break;
+        if (s.state == SlotState::Dead)
+        {
+            if (!reuse)
+                reuse = &s;
+        }
+        else if (s.pid == pid && s.createTime == createTime)
+        {
+            s.epoch = epoch;
+            return s.rec;
+        }
+    }
+
+    Slot &s = reuse ? *reuse : slots[i];
+    if (reuse)
+        --dead;
+    ++live;
+    s.pid = pid;
+    s.createTime = createTime;
+    s.epoch = epoch;
+    s.state = SlotState::Live;
+    s.rec = ProcRecord{};
+    return s.rec;
+}
+
+void ProcRegistry::Sweep()
+{
+    StringPool::Batch strings(Strings());
+    for (Slot &s : slots)
+    {
+        if (s.state != SlotState::Live || s.epoch == epoch)
+            continue;
+        strings.Release(s.rec.name);
+        strings.Release(s.rec.userName);
+        strings.Release(s.rec.cmdline);
+        s.state = SlotState::Dead;
+        s.rec = ProcRecord{};
+        --live;
+        ++dead;
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <windows.h>
+#include <cstdint>
+#include <vector>
+#include "string_pool.h"
+
+// What the sampler keeps about one process from tick to tick.
+struct ProcRecord
+{
+    // CPU times at the previous sample; only meaningful once haveCpu is set.
+    ULONGLONG kernel = 0, user = 0;
+    bool haveCpu = false;
+    // Interned in Strings(), one reference each held by the record. Looked
+    // up on demand and kept; kNoStr until a lookup succeeded.
+    StrId name = kNoStr, userName = kNoStr, cmdline = kNoStr;
+};
+
+// Per-process records in one open-addressing table keyed by pid and
+// creation time, so a recycled pid starts from a blank record instead of
+// inheriting the old process's CPU baseline and strings. Records that were
+// not touched during a tick are dropped by Sweep().
+class ProcRegistry
+{
+public:
+    // Starts a tick for up to `processes` processes. The table does not move
+    // again before Sweep(), so references from Touch() stay valid until then.
+    void BeginTick(size_t processes);
+    // The record for this process; a blank one the first time it is seen.
+    ProcRecord &Touch(DWORD pid, ULONGLONG createTime);
+    // Drops the records of processes not touched since BeginTick(), and
+    // their string references.
+    void Sweep();
+
+    size_t Size() const { return live; }
+
+private:
+    enum class SlotState : uint8_t
+    {
+        Empty,
+        Live,
+        Dead,
+    };
+    struct Slot
+    {
+        DWORD pid = 0;
+        ULONGLONG createTime = 0;
+        uint32_t epoch = 0;
+        SlotState state = SlotState::Empty;
+        ProcRecord rec;
+    };
+
+    void Rehash(size_t capacity);
+
+    std::vector<Slot> slots;
+    size_t live = 0, dead = 0;
+    uint32_t epoch = 0;
+};
@@ -2,14 +2,22 @@
 
 #include <thread>
 #include <chrono>
-#include <unordered_map>
-#include <unordered_set>
 #include <algorithm>
+#include <memory>
 
 #include "metrics.h"
+#include "host_info.h"
 #include "metrics_process.h"
+#include "proc_registry.h"
 #include "pdh_metrics.h"
 
+// Points a record's string at `id`, dropping the reference on the old one.
+static void Replace(StrId &slot, StrId id)
+{
+    StringPool::Batch(Strings()).Release(slot);
+    slot = id;
+}
+
 void Sampler::start()
 {
     if (on.exchange(true))
@@ -28,32 +36,24 @@ void Sampler::run()
 {
     PdhInit();
 
-    SYSTEM_INFO si{};
-    GetSystemInfo(&si);
-    const int logicalCores = (int)si.dwNumberOfProcessors;
+    const int logicalCores = Host().logicalCores;
 
     CpuTimes prevSys{}, currSys{};
     GetSystemCpuTimes(prevSys);
 
-    struct PrevCpu
-    {
-        ULONGLONG k = 0, u = 0;
-    };
-    std::unordered_map<DWORD, PrevCpu> prevByPid;
-
-    std::unordered_map<DWORD, std::wstring> cacheUser;
-    std::unordered_map<DWORD, std::wstring> cacheCmd;
-    std::unordered_map<DWORD, std::wstring> cacheName;
+    ProcRegistry registry;
+    // Reused from tick to tick.
+    std::vector<ProcRaw> raw;
+    std::vector<ProcRecord *> records;
+    std::vector<uint32_t> byMem;
+    Ring<double> cpuHist{180}, memHist{180};
+    unsigned long long generation = 0;
 
     while (on)
     {
         auto t0 = std::chrono::steady_clock::now();
 
-        int localHz = 5;
-        {
-            std::scoped_lock lk(st.m);
-            localHz = std::max(1, st.hz);
-        }
+        const int localHz = std::max(1, st.hz.load(std::memory_order_relaxed));
         const double elapsedSec = 1.0 / (double)localHz;
 
         GetSystemCpuTimes(currSys);
@@ -63,20 +63,18 @@ void Sampler::run()
         MemInfo mem = GetMemoryInfo();
         auto perCore = PdhSamplePerCoreCpu();
 
-        std::vector<ProcRaw> raw;
         SnapshotProcesses(raw);
 
         const long double TICKS_PER_SEC = 10000000.0L;
 
         std::vector<ProcInfo> procs;
         procs.reserve(raw.size());
-
-        std::unordered_set<DWORD> alive;
-        alive.reserve(raw.size());
+        records.clear();
+        registry.BeginTick(raw.size());
 
         for (const auto &r : raw)
         {
-            alive.insert(r.pid);
+            ProcRecord &rec = registry.Touch(r.pid, r.createTime);
 
             ProcInfo p{};
             p.pid = r.pid;
@@ -84,98 +82,90 @@ void Sampler::run()
             p.workingSet = r.workingSet;
 
             if (!r.imageName.empty())
-                p.name = r.imageName;
-            else
             {
-                auto itN = cacheName.find(p.pid);
-                if (itN != cacheName.end())
-                    p.name = itN->second;
-                else
-                {
-                    p.name = GetProcessBaseNameLazy(p.pid);
-                    cacheName[p.pid] = p.name;
-                }
+                if (Strings().Get(rec.name) != r.imageName)
+                    Replace(rec.name, Strings().Intern(r.imageName));
             }
+            else if (rec.name == kNoStr)
+                rec.name = Strings().Intern(GetProcessBaseNameLazy(p.pid));
+            p.name = rec.name;
 
-            PrevCpu now{r.kernel, r.user};
-            auto itPrev = prevByPid.find(p.pid);
+            // A process seen for the first time has no baseline yet and
+            // shows 0% for one tick.
             double pct = 0.0;
-            if (itPrev != prevByPid.end())
+            if (rec.haveCpu)
             {
-                long double dk = (long double)(now.k - itPrev->second.k);
-                long double du = (long double)(now.u - itPrev->second.u);
+                long double dk = (long double)(r.kernel - rec.kernel);
+                long double du = (long double)(r.user - rec.user);
                 long double busy = dk + du;
                 pct = (double)(busy / (elapsedSec * (double)TICKS_PER_SEC * (double)logicalCores) * 100.0);
             }
-            prevByPid[p.pid] = now;
+            rec.kernel = r.kernel;
+            rec.user = r.user;
+            rec.haveCpu = true;
             if (pct < 0)
                 pct = 0;
             if (pct > 999.9)
                 pct = 999.9;
             p.cpu_percent = pct;
+            FormatProcText(p);
 
             procs.emplace_back(std::move(p));
+            records.push_back(&rec);
+        }
+
+        // User and command line only for the processes using the most
+        // memory; the lookups are expensive.
+        const size_t FILL_LIMIT = std::min<size_t>(procs.size(), 120);
+        byMem.resize(procs.size());
+        for (size_t i = 0; i < byMem.size(); ++i)
+            byMem[i] = (uint32_t)i;
+        std::nth_element(byMem.begin(), byMem.begin() + FILL_LIMIT, byMem.end(),
+                         [&](uint32_t a, uint32_t b)
+                         { return procs[a].workingSet > procs[b].workingSet; });
+        for (size_t k = 0; k < FILL_LIMIT; ++k)
+        {
+            auto &p = procs[byMem[k]];
+            ProcRecord &rec = *records[byMem[k]];
+
+            if (rec.userName == kNoStr)
+                rec.userName = Strings().Intern(GetProcessUserLazy(p.pid));
+            p.user = rec.userName;
+            if (rec.cmdline == kNoStr)
+                rec.cmdline = Strings().Intern(GetProcessCommandLineLazy(p.pid));
+            p.cmdline = rec.cmdline;
         }
 
         std::sort(procs.begin(), procs.end(),
                   [](const ProcInfo &a, const ProcInfo &b)
                   { return a.workingSet > b.workingSet; });
 
-        const size_t FILL_LIMIT = std::min<size_t>(procs.size(), 120);
-        for (size_t i = 0; i < FILL_LIMIT; ++i)
-        {
-            auto &p = procs[i];
+        std::wstring diskLine = PdhSampleDiskLine();
+        std::wstring netLine = PdhSampleNetLine();
 
-            if (p.user.empty())
-            {
-                auto itU = cacheUser.find(p.pid);
-                if (itU != cacheUser.end())
-                    p.user = itU->second;
-                else
-                {
-                    std::wstring u = GetProcessUserLazy(p.pid);
-                    if (!u.empty())
-                    {
-                        cacheUser[p.pid] = u;
-                        p.user = std::move(u);
-                    }
-                }
-            }
-            if (p.cmdline.empty())
-            {
-                auto itC = cacheCmd.find(p.pid);
-                if (itC != cacheCmd.end())
-                    p.cmdline = itC->second;
-                else
-                {
-                    std::wstring cmd = GetProcessCommandLineLazy(p.pid);
-                    if (!cmd.empty())
-                    {
-                        cacheCmd[p.pid] = cmd;
-                        p.cmdline = std::move(cmd);
-                    }
-                }
-            }
-        }
+        cpuHist.push(cpuTotal);
+        memHist.push(mem.percent);
 
-        {
-            std::scoped_lock lk(st.m);
-            st.cpuTotal = cpuTotal;
-            st.cpuCores = std::move(perCore);
-            st.mem = mem;
-            st.procs = std::move(procs);
-            st.cpuHist.push(cpuTotal);
-            st.memHist.push(mem.percent);
-        }
+        Telemetry tm;
+        tm.cpuTotal = cpuTotal;
+        tm.mem = mem;
+        st.telemetry.Store(tm);
+
+        auto snap = std::make_shared<Snapshot>();
+        snap->procs = std::move(procs);
+        snap->cpuCores = std::move(perCore);
+        snap->HoldStrings();
+        snap->diskLine = std::move(diskLine);
+        snap->netLine = std::move(netLine);
+        snap->cpuHist = cpuHist;
+        snap->memHist = memHist;
+        snap->generation = ++generation;
+        st.Publish(std::move(snap));
+
+        if (publish)
+            publish();
 
-        for (auto it = prevByPid.begin(); it != prevByPid.end();)
-            it = (alive.count(it->first) ? std::next(it) : prevByPid.erase(it));
-        for (auto it = cacheUser.begin(); it != cacheUser.end();)
-            it = (alive.count(it->first) ? std::next(it) : cacheUser.erase(it));
-        for (auto it = cacheCmd.begin(); it != cacheCmd.end();)
-            it = (alive.count(it->first) ? std::next(it) : cacheCmd.erase(it));
-        for (auto it = cacheName.begin(); it != cacheName.end();)
-            it = (alive.count(it->first) ? std::next(it) : cacheName.erase(it));
+        registry.Sweep();
 
         auto frame = std::chrono::duration<double>(1.0 / (double)localHz);
         auto elapsed = std::chrono::steady_clock::now() - t0;
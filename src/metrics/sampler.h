@@ -1,12 +1,15 @@
 #pragma once
 #include <atomic>
+#include <functional>
 #include <thread>
 #include "state.h"
 
 class Sampler
 {
 public:
-    explicit Sampler(AppState &s) : st(s) {}
+    // `onPublish` runs on the sampler thread after every new snapshot.
+    explicit Sampler(AppState &s, std::function<void()> onPublish = {})
+        : st(s), publish(std::move(onPublish)) {}
     void start();
     void stop();
 
@@ -14,6 +17,7 @@ private:
     void run();
 
     AppState &st;
+    std::function<void()> publish;
     std::atomic<bool> on{false};
     std::thread th;
 };
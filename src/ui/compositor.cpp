@@ -0,0 +1,73 @@
+#include "compositor.h"
+
+#include <algorithm>
+#include <iterator>
+
+bool Compositor::Fit(const CellGrid &g)
+{
+    if (base_.Cols() == g.Cols() && base_.Rows() == g.Rows())
+        return false;
+    base_.Resize(g.Cols(), g.Rows());
+    top_.Resize(g.Cols(), g.Rows());
+    overlay_ = {};
+    all_ = true;
+    return true;
+}
+
+void Compositor::BaseChanged(const Rect &r)
+{
+    if (all_ || r.Empty())
+        return;
+    if (dirtyCount_ == (int)std::size(dirty_))
+        all_ = true;
+    else
+        dirty_[dirtyCount_++] = r;
+}
+
+void Compositor::OverlayChanged(const Rect &r)
+{
+    // What the old rectangle hid and what the new one shows.
+    BaseChanged(overlay_);
+    overlay_ = r;
+    BaseChanged(overlay_);
+}
+
+void Compositor::Copy(CellGrid &g, const Rect &r) const
+{
+    const int top = std::max<int>(r.top, 1), left = std::max<int>(r.left, 1);
+    const int bottom = std::min<int>(r.top + r.height - 1, g.Rows());
+    const int right = std::min<int>(r.left + r.width - 1, g.Cols());
+    const Rect &o = overlay_;
+    for (int row = top; row <= bottom; ++row)
+    {
+        Cell *dst = g.At(row, 1);
+        const Cell *base = base_.Row(row);
+        const Cell *over = top_.Row(row);
+        const bool overRow = !o.Empty() && row >= o.top && row < o.top + o.height;
+        for (int col = left; col <= right; ++col)
+        {
+            const bool covered = overRow && col >= o.left && col < o.left + o.width;
+            dst[col - 1] = covered ? over[col - 1] : base[col - 1];
+        }
+    }
+}
+
+void Compositor::Compose(CellGrid &g)
+{
+    if (g.Epoch() != composedEpoch_)
+        all_ = true;
+    if (all_)
+        Copy(g, {1, 1, (short)g.Rows(), (short)g.Cols()});
+    else
+        for (int i = 0; i < dirtyCount_; ++i)
+            Copy(g, dirty_[i]);
+    dirtyCount_ = 0;
+    all_ = false;
+    composedEpoch_ = g.Epoch();
+
+    // Still worth it under an overlay: Present() resends the overlay cells
+    // the scroll moved.
+    const ScrollHint h = base_.TakeScrollHint();
+    if (h.delta != 0)
+        g.HintScroll(h.top, h.bottom, h.delta);
+}
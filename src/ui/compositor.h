@@ -0,0 +1,39 @@
+#pragma once
+#include "screen.h"
+#include "widget.h"
+
+// The frame as two layers: the base panels and at most one overlay
+// rectangle above them. Each layer keeps its own cells, so the base goes on
+// updating under an open overlay and closing it needs no redraw. Compose()
+// copies into the back buffer only the cells either layer changed.
+class Compositor
+{
+public:
+    // Sizes both layers like `g`. Returns true when that reset them.
+    bool Fit(const CellGrid &g);
+
+    CellGrid &Base() { return base_; }
+    CellGrid &Top() { return top_; }
+
+    // The base cells in `r` were redrawn.
+    void BaseChanged(const Rect &r);
+    // The overlay now covers `r` (empty: no overlay) and its cells in Top()
+    // were redrawn.
+    void OverlayChanged(const Rect &r);
+
+    // Overlay rectangle currently shown; empty when there is none.
+    const Rect &Overlay() const { return overlay_; }
+
+    void Compose(CellGrid &g);
+
+private:
+    void Copy(CellGrid &g, const Rect &r) const;
+
+    CellGrid base_, top_;
+    Rect overlay_;
+    // Regions to copy on the next Compose(); `all` once the list overflows.
+    Rect dirty_[12];
+    int dirtyCount_ = 0;
+    bool all_ = true;
+    uint64_t composedEpoch_ = 0;
+};
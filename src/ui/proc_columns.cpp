@@ -0,0 +1,54 @@
+#include "proc_columns.h"
+
+#include <bit>
+
+// Spreads the low bits of `v` over the set bits of `mask`, lowest first.
+static constexpr uint32_t Deposit(uint32_t v, uint32_t mask)
+{
+    uint32_t out = 0;
+    for (uint32_t bit = 1; mask; bit <<= 1)
+    {
+        const uint32_t low = mask & (~mask + 1);
+        if (v & bit)
+            out |= low;
+        mask &= mask - 1;
+    }
+    return out;
+}
+
+// The inverse: gathers the bits of `v` under `mask` into the low bits.
+static uint32_t Extract(uint32_t v, uint32_t mask)
+{
+    uint32_t out = 0;
+    for (uint32_t bit = 1; mask; bit <<= 1)
+    {
+        if (v & mask & (~mask + 1))
+            out |= bit;
+        mask &= mask - 1;
+    }
+    return out;
+}
+
+// One formatter per subset of the optional columns, unselected then
+// selected.
+static constexpr int kColumnSets = 1 << std::popcount(kOptionalProcColumns);
+
+template <size_t... S>
+static constexpr auto MakeFormatters(std::index_sequence<S...>)
+{
+    constexpr uint32_t base = kAllProcColumns & ~kOptionalProcColumns;
+    struct
+    {
+        ProcRowFormatter plain[kColumnSets], selected[kColumnSets];
+    } t = {{&FormatProcRow<base | Deposit(S, kOptionalProcColumns), false>...},
+           {&FormatProcRow<base | Deposit(S, kOptionalProcColumns), true>...}};
+    return t;
+}
+
+static constexpr auto kFormatters = MakeFormatters(std::make_index_sequence<kColumnSets>{});
+
+ProcRowFormatter ProcRowFormatterFor(uint32_t columns, bool selected)
+{
+    const uint32_t set = Extract(columns, kOptionalProcColumns);
+    return selected ? kFormatters.selected[set] : kFormatters.plain[set];
+}
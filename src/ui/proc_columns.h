@@ -0,0 +1,176 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+#include "fmt.h"
+#include "metrics.h"
+#include "screen.h"
+#include "theme.h"
+
+// Columns of the process table, left to right. Adding one takes an entry
+// here, a row in kProcColumns and a ProcCell specialization.
+enum class ProcCol : uint8_t
+{
+    Pid,
+    Name,
+    Cmd,
+    Threads,
+    User,
+    Mem,
+    Cpu,
+};
+inline constexpr int kProcColCount = 7;
+
+// Fixed columns always take `width` cells. Flex columns share what is left
+// in proportion to `share`, each at least `width` wide; the last one takes
+// the remainder. Optional columns are flex columns that are dropped when
+// the minimum widths do not fit.
+enum class ColWidth : uint8_t
+{
+    Fixed,
+    Flex,
+    Optional,
+};
+
+struct ProcColumn
+{
+    ProcCol key;
+    const wchar_t *title;
+    ColWidth policy;
+    short width;
+    short share;
+    ColorRole color;
+    // Title and figures are right-aligned.
+    bool right;
+    // AppState::procSort value that orders rows by this column, or -1.
+    int sortKey;
+};
+
+inline constexpr ProcColumn kProcColumns[kProcColCount] = {
+    {ProcCol::Pid, L"Pid", ColWidth::Fixed, 5, 0, ColorRole::Hdr, true, 2},
+    {ProcCol::Name, L"Program", ColWidth::Flex, 10, 1, ColorRole::Text, false, 3},
+    {ProcCol::Cmd, L"Command", ColWidth::Optional, 15, 3, ColorRole::Dim, false, -1},
+    {ProcCol::Threads, L"Threads", ColWidth::Fixed, 7, 0, ColorRole::Hdr, true, -1},
+    {ProcCol::User, L"User", ColWidth::Flex, 10, 1, ColorRole::Dim, false, -1},
+    {ProcCol::Mem, L"MemB", ColWidth::Fixed, 11, 0, ColorRole::BarHi, false, 0},
+    {ProcCol::Cpu, L"Cpu%", ColWidth::Fixed, 6, 0, ColorRole::BarLo, true, 1},
+};
+
+constexpr const ProcColumn &Column(ProcCol c) { return kProcColumns[(int)c]; }
+constexpr uint32_t ColumnBit(ProcCol c) { return 1u << (int)c; }
+
+constexpr bool ProcColumnsInOrder()
+{
+    for (int i = 0; i < kProcColCount; ++i)
+        if ((int)kProcColumns[i].key != i)
+            return false;
+    return true;
+}
+static_assert(ProcColumnsInOrder(), "kProcColumns must list the columns in ProcCol order");
+
+inline constexpr uint32_t kAllProcColumns = (1u << kProcColCount) - 1;
+inline constexpr uint32_t kOptionalProcColumns = []
+{
+    uint32_t m = 0;
+    for (const ProcColumn &c : kProcColumns)
+        if (c.policy == ColWidth::Optional)
+            m |= ColumnBit(c.key);
+    return m;
+}();
+
+// How each column writes its cell, and for sortable columns which of two
+// rows is listed first. `width` is the column's width in cells.
+template <ProcCol C>
+struct ProcCell;
+
+template <>
+struct ProcCell<ProcCol::Pid>
+{
+    static void Put(Pen &p, const ProcInfo &pi, int width) { FmtUInt(p, pi.pid, width); }
+    static bool Before(const ProcInfo &a, const ProcInfo &b) { return a.pid < b.pid; }
+};
+
+template <>
+struct ProcCell<ProcCol::Name>
+{
+    static void Put(Pen &p, const ProcInfo &pi, int width) { FmtEllipsis(p, Strings().Get(pi.name), width); }
+    static bool Before(const ProcInfo &a, const ProcInfo &b)
+    {
+        return a.name != b.name && Strings().Get(a.name) < Strings().Get(b.name);
+    }
+};
+
+template <>
+struct ProcCell<ProcCol::Cmd>
+{
+    static void Put(Pen &p, const ProcInfo &pi, int width)
+    {
+        FmtMiddleEllipsis(p, Strings().Get(pi.cmdline != kNoStr ? pi.cmdline : pi.name), width);
+    }
+};
+
+template <>
+struct ProcCell<ProcCol::Threads>
+{
+    static void Put(Pen &p, const ProcInfo &pi, int width) { FmtUInt(p, pi.threads, width); }
+};
+
+template <>
+struct ProcCell<ProcCol::User>
+{
+    static void Put(Pen &p, const ProcInfo &pi, int width) { FmtEllipsis(p, Strings().Get(pi.user), width); }
+};
+
+template <>
+struct ProcCell<ProcCol::Mem>
+{
+    static void Put(Pen &p, const ProcInfo &pi, int width) { FmtField(p, pi.memText, width, false); }
+    static bool Before(const ProcInfo &a, const ProcInfo &b) { return a.workingSet > b.workingSet; }
+};
+
+template <>
+struct ProcCell<ProcCol::Cpu>
+{
+    static void Put(Pen &p, const ProcInfo &pi, int width) { FmtField(p, pi.cpuText, width, true); }
+    static bool Before(const ProcInfo &a, const ProcInfo &b) { return a.cpu_percent > b.cpu_percent; }
+    static ColorRole Color(const ProcInfo &pi)
+    {
+        static constexpr ColorRole byLoad[] = {ColorRole::BarLo, ColorRole::Warn, ColorRole::Crit};
+        return byLoad[(int)pi.load];
+    }
+};
+
+template <uint32_t Mask, ProcCol C, bool Selected>
+inline void PutProcColumn(Pen &p, const ProcInfo &pi, const short *colW)
+{
+    constexpr uint32_t bit = ColumnBit(C);
+    if constexpr ((Mask & bit) != 0)
+    {
+        if constexpr ((Mask & (bit - 1)) != 0)
+            p.Put(U' ');
+        if constexpr (Selected)
+            p.Fg(ColorRole::SelFg);
+        else if constexpr (requires { ProcCell<C>::Color(pi); })
+            p.Fg(ProcCell<C>::Color(pi));
+        else
+            p.Fg(Column(C).color);
+        ProcCell<C>::Put(p, pi, colW[(int)C]);
+    }
+}
+
+// Writes one row's cells for the columns in `Mask`. Instantiated per column
+// set and selection state, so which columns are shown, their separators
+// and colours are all fixed at compile time.
+template <uint32_t Mask, bool Selected>
+void FormatProcRow(Pen &p, const ProcInfo &pi, const short *colW)
+{
+    [&]<size_t... I>(std::index_sequence<I...>)
+    {
+        (PutProcColumn<Mask, (ProcCol)I, Selected>(p, pi, colW), ...);
+    }(std::make_index_sequence<kProcColCount>{});
+}
+
+using ProcRowFormatter = void (*)(Pen &, const ProcInfo &, const short *);
+
+// The generated formatter for a column set; `columns` may lack any of the
+// optional columns.
+ProcRowFormatter ProcRowFormatterFor(uint32_t columns, bool selected);
@@ -0,0 +1,98 @@
+#include "proc_view.h"
+#include "proc_columns.h"
+
+#include <algorithm>
+#include <utility>
+
+// Grows the sorted run [sortedFirst, sortedLast) of `order` to cover
+// [first, last), sorting only the rows it did not cover yet. The run at
+// least doubles each time it grows, so scrolling through n rows goes back
+// to the unsorted rest only O(log n) times. A window that does not touch
+// the run starts a new one.
+template <class Less>
+static void SortWindow(std::vector<uint32_t> &order, int &sortedFirst, int &sortedLast,
+                       int first, int last, Less less)
+{
+    if (sortedFirst == sortedLast || last < sortedFirst || first > sortedLast)
+    {
+        if (first > 0)
+            std::nth_element(order.begin(), order.begin() + first, order.end(), less);
+        std::partial_sort(order.begin() + first, order.begin() + last, order.end(), less);
+        sortedFirst = first;
+        sortedLast = last;
+        return;
+    }
+    const int run = sortedLast - sortedFirst;
+    if (first < sortedFirst)
+    {
+        first = std::max(0, std::min(first, sortedFirst - run));
+        if (first > 0)
+            std::nth_element(order.begin(), order.begin() + first, order.begin() + sortedFirst, less);
+        std::sort(order.begin() + first, order.begin() + sortedFirst, less);
+        sortedFirst = first;
+    }
+    if (last > sortedLast)
+    {
+        last = std::min((int)order.size(), std::max(last, sortedLast + run));
+        std::partial_sort(order.begin() + sortedLast, order.begin() + last, order.end(), less);
+        sortedLast = last;
+    }
+}
+
+// Sort orders with pid as the tie-break, so rows with equal keys keep their
+// relative order from frame to frame.
+template <ProcCol C>
+static bool SortByColumn(std::vector<uint32_t> &order, int &sortedFirst, int &sortedLast,
+                         const std::vector<ProcInfo> &procs, int first, int last, int sortKey)
+{
+    if constexpr (Column(C).sortKey >= 0)
+        if (sortKey == Column(C).sortKey)
+        {
+            auto less = [&](uint32_t a, uint32_t b)
+            {
+                const ProcInfo &pa = procs[a], &pb = procs[b];
+                if (ProcCell<C>::Before(pa, pb))
+                    return true;
+                if (ProcCell<C>::Before(pb, pa))
+                    return false;
+                return pa.pid < pb.pid;
+            };
+            SortWindow(order, sortedFirst, sortedLast, first, last, less);
+            return true;
+        }
+    return false;
+}
+
+void ProcView::Update(const std::vector<ProcInfo> &procs, unsigned long long generation, int sortKey,
+                      int first, int count)
+{
+    const int n = (int)procs.size();
+    if (&procs != procs_ || generation != generation_ || sortKey != sortKey_ || n != (int)order_.size())
+    {
+        procs_ = &procs;
+        generation_ = generation;
+        sortKey_ = sortKey;
+        order_.resize(n);
+        for (int i = 0; i < n; ++i)
+            order_[i] = (uint32_t)i;
+        sortedFirst_ = sortedLast_ = 0;
+    }
+
+    first_ = std::clamp(first, 0, n);
+    last_ = std::clamp(first_ + std::max(0, count), first_, n);
+    if (first_ == last_ || (sortedFirst_ <= first_ && last_ <= sortedLast_))
+        return;
+
+    // Sort a page either side as well, so scrolling a few rows at a time
+    // rarely has to go back to the unsorted rows.
+    const int page = last_ - first_;
+    const int from = std::max(0, first_ - page), to = std::min(n, last_ + page);
+
+    // The column whose sortKey matches orders the rows; memory otherwise.
+    const bool sorted = [&]<size_t... I>(std::index_sequence<I...>)
+    {
+        return (SortByColumn<(ProcCol)I>(order_, sortedFirst_, sortedLast_, procs, from, to, sortKey) || ...);
+    }(std::make_index_sequence<kProcColCount>{});
+    if (!sorted)
+        SortByColumn<ProcCol::Mem>(order_, sortedFirst_, sortedLast_, procs, from, to, Column(ProcCol::Mem).sortKey);
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "metrics.h"
+
+// Sorted view of a process snapshot. Keeps an index permutation over the
+// caller's vector instead of a sorted copy, and only puts the rows around
+// the visible window in order: everything before them is partitioned off
+// with nth_element, the rows themselves are partial_sorted.
+//
+// The permutation is kept while the snapshot and sort order stay the same,
+// so scrolling or moving the selection only sorts rows the view has not
+// reached yet.
+class ProcView
+{
+public:
+    // Orders rows [first, first + count) of `procs` by `sortKey` (the
+    // AppState::procSort values). `generation` names the snapshot `procs`
+    // belongs to. `procs` must outlive the next Row() call.
+    void Update(const std::vector<ProcInfo> &procs, unsigned long long generation, int sortKey,
+                int first, int count);
+
+    int Size() const { return (int)order_.size(); }
+    int First() const { return first_; }
+    int Last() const { return last_; }
+
+    // Row at sorted position `i`; only valid for First() <= i < Last().
+    const ProcInfo &Row(int i) const { return (*procs_)[order_[i]]; }
+
+private:
+    const std::vector<ProcInfo> *procs_ = nullptr;
+    unsigned long long generation_ = 0;
+    int sortKey_ = -1;
+    std::vector<uint32_t> order_;
+    // order_ is sorted over [sortedFirst_, sortedLast_); rows before that
+    // sort no later than it, rows after it no earlier.
+    int sortedFirst_ = 0, sortedLast_ = 0;
+    int first_ = 0, last_ = 0;
+};
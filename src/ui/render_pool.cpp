@@ -0,0 +1,80 @@
+#include "render_pool.h"
+
+void RenderPool::start(int workers)
+{
+    stop();
+    quit = false;
+    for (int i = 0; i < workers; ++i)
+        threads.emplace_back(&RenderPool::run, this);
+}
+
+void RenderPool::stop()
+{
+    {
+        std::scoped_lock lk(m);
+        quit = true;
+    }
+    wake.notify_all();
+    for (auto &t : threads)
+        t.join();
+    threads.clear();
+}
+
+void RenderPool::RunJobs(int jobs, Job fn, const void *fnCtx)
+{
+    if (threads.empty() || jobs <= 1)
+    {
+        for (int i = 0; i < jobs; ++i)
+            fn(fnCtx, i);
+        return;
+    }
+    {
+        std::scoped_lock lk(m);
+        job = fn;
+        ctx = fnCtx;
+        next = 0;
+        count = remaining = jobs;
+        ++batch;
+    }
+    wake.notify_all();
+    Help();
+
+    std::unique_lock lk(m);
+    done.wait(lk, [&]
+              { return remaining == 0; });
+    job = nullptr;
+    ctx = nullptr;
+}
+
+void RenderPool::Help()
+{
+    std::unique_lock lk(m);
+    while (next < count)
+    {
+        const int i = next++;
+        const Job fn = job;
+        const void *fnCtx = ctx;
+        lk.unlock();
+        fn(fnCtx, i);
+        lk.lock();
+        if (--remaining == 0)
+            done.notify_one();
+    }
+}
+
+void RenderPool::run()
+{
+    unsigned long long seen = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock lk(m);
+            wake.wait(lk, [&]
+                      { return quit || batch != seen; });
+            if (quit)
+                return;
+            seen = batch;
+        }
+        Help();
+    }
+}
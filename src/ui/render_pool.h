@@ -0,0 +1,46 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A few threads that help draw one frame. Run() hands job indexes to the
+// workers and to the calling thread alike and returns once all of them have
+// finished. One Run() at a time, from one thread.
+class RenderPool
+{
+public:
+    ~RenderPool() { stop(); }
+
+    // Restarts with `workers` threads besides the caller; 0 runs every job
+    // on the caller.
+    void start(int workers);
+    void stop();
+
+    int Workers() const { return (int)threads.size(); }
+
+    // Calls fn(i) for every i in [0, jobs).
+    template <typename Fn>
+    void Run(int jobs, const Fn &fn)
+    {
+        RunJobs(jobs, [](const void *ctx, int i)
+                { (*static_cast<const Fn *>(ctx))(i); }, &fn);
+    }
+
+private:
+    using Job = void (*)(const void *ctx, int i);
+
+    void RunJobs(int jobs, Job fn, const void *ctx);
+    void run();
+    // Takes jobs of the current batch until none are left.
+    void Help();
+
+    std::mutex m;
+    std::condition_variable wake, done;
+    Job job = nullptr;
+    const void *ctx = nullptr;
+    int next = 0, count = 0, remaining = 0;
+    unsigned long long batch = 0;
+    bool quit = false;
+    std::vector<std::thread> threads;
+};
@@ -0,0 +1,41 @@
+#include "row_cache.h"
+
+#include <algorithm>
+
+bool RowCache::Fetch(const ProcRowKey &key, Cell *dst)
+{
+    auto it = rows_.find(key.pid);
+    if (it == rows_.end() || !(it->second.key == key))
+    {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    Entry &e = it->second;
+    std::copy(e.cells.begin(), e.cells.end(), dst);
+    e.frame = frame_;
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void RowCache::Store(const ProcRowKey &key, const Cell *src)
+{
+    Entry &e = rows_[key.pid];
+    e.key = key;
+    e.cells.assign(src, src + key.width);
+    e.frame = frame_;
+}
+
+void RowCache::EndFrame(size_t keep)
+{
+    if (rows_.size() > keep)
+    {
+        for (auto it = rows_.begin(); it != rows_.end();)
+        {
+            if (it->second.frame != frame_)
+                it = rows_.erase(it);
+            else
+                ++it;
+        }
+    }
+    ++frame_;
+}
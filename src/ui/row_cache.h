@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "metrics.h"
+#include "proc_columns.h"
+#include "screen.h"
+
+// Everything that decides how a process row looks.
+struct ProcRowKey
+{
+    DWORD pid = 0;
+    DWORD threads = 0;
+    // Interned, so comparing ids compares the strings.
+    StrId name = kNoStr, user = kNoStr, cmdline = kNoStr;
+    // Figures as displayed, so changes below their precision still hit.
+    FmtAscii<12> mem;
+    FmtAscii<8> cpu;
+    CpuLoad load = CpuLoad::Low;
+    short colW[kProcColCount] = {};
+    short width = 0;
+    bool selected = false;
+    unsigned paletteGen = 0;
+
+    bool operator==(const ProcRowKey &) const = default;
+};
+
+// Formatted process rows from earlier frames, one per pid. A row whose key
+// is unchanged is copied back into the grid instead of being
+// formatted again. Fetch() may run on several threads at once for distinct
+// pids as long as nothing else is called meanwhile.
+class RowCache
+{
+public:
+    // Copies the cached cells for `p` into `dst` and returns true on a hit.
+    bool Fetch(const ProcRowKey &key, Cell *dst);
+    void Store(const ProcRowKey &key, const Cell *src);
+
+    // Once the cache holds more than `keep` rows, drops those not used
+    // since the previous EndFrame().
+    void EndFrame(size_t keep);
+
+    uint64_t Hits() const { return hits_.load(std::memory_order_relaxed); }
+    uint64_t Misses() const { return misses_.load(std::memory_order_relaxed); }
+
+private:
+    struct Entry
+    {
+        ProcRowKey key;
+        std::vector<Cell> cells;
+        uint64_t frame = 0;
+    };
+
+    std::unordered_map<DWORD, Entry> rows_;
+    uint64_t frame_ = 0;
+    std::atomic<uint64_t> hits_{0}, misses_{0};
+};
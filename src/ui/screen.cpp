@@ -0,0 +1,251 @@
+#include "screen.h"
+#include "fmt.h"
+
+#include <algorithm>
+#include <string_view>
+
+static uint64_t g_gridEpoch = 0;
+
+void CellGrid::Resize(int cols, int rows)
+{
+    epoch_ = ++g_gridEpoch;
+    cols_ = cols > 0 ? cols : 0;
+    rows_ = rows > 0 ? rows : 0;
+    cells_.assign((size_t)cols_ * rows_, Cell{});
+}
+
+void CellGrid::Fill(const Cell &c)
+{
+    epoch_ = ++g_gridEpoch;
+    std::fill(cells_.begin(), cells_.end(), c);
+}
+
+static void AppendInt(std::string &out, int v)
+{
+    char buf[12];
+    int n = 0;
+    do
+    {
+        buf[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v > 0 && n < 12);
+    while (n > 0)
+        out.push_back(buf[--n]);
+}
+
+// Tracks the SGR state the terminal is in and emits only the parts of it
+// that differ from the next cell: one combined CSI ... m per change.
+class SgrTracker
+{
+public:
+    explicit SgrTracker(const Palette &pal) : pal_(pal) {}
+
+    void Apply(std::string &out, const Cell &c)
+    {
+        if (known_ && c.fg == fg_ && c.bg == bg_ && c.attr == attr_)
+            return;
+
+        out += "\x1b[";
+        bool first = true;
+        auto param = [&](std::string_view p)
+        {
+            if (!first)
+                out.push_back(';');
+            out += p;
+            first = false;
+        };
+
+        if (!known_)
+        {
+            param("0");
+            attr_ = 0;
+            fg_ = bg_ = kColorDefault;
+        }
+        if ((c.attr & kAttrBold) != (attr_ & kAttrBold))
+            param((c.attr & kAttrBold) ? "1" : "22");
+        if ((c.attr & kAttrUnderline) != (attr_ & kAttrUnderline))
+            param((c.attr & kAttrUnderline) ? "4" : "24");
+        if (c.fg != fg_)
+            param(pal_.FgParams(c.fg));
+        if (c.bg != bg_)
+            param(pal_.BgParams(c.bg));
+        out.push_back('m');
+
+        known_ = true;
+        fg_ = c.fg;
+        bg_ = c.bg;
+        attr_ = c.attr;
+    }
+
+    bool Known() const { return known_; }
+
+private:
+    const Palette &pal_;
+    bool known_ = false;
+    ColorIndex fg_ = kColorDefault, bg_ = kColorDefault;
+    uint8_t attr_ = 0;
+};
+
+Pen &Pen::Text(std::wstring_view s)
+{
+    FmtText(*this, s);
+    return *this;
+}
+
+Pen &Pen::Fill(char32_t ch, int count)
+{
+    for (int i = 0; i < count; ++i)
+        Put(ch);
+    return *this;
+}
+
+Pen &Pen::ClearTo(int lastCol)
+{
+    while (col_ <= lastCol)
+        Put(U' ');
+    return *this;
+}
+
+bool Screen::Resize(int cols, int rows)
+{
+    if (cols == back_.Cols() && rows == back_.Rows())
+        return false;
+    back_.Resize(cols, rows);
+    front_.Resize(cols, rows);
+    full_ = true;
+    undo_.valid = false;
+    return true;
+}
+
+void Screen::Rollback()
+{
+    if (!undo_.valid)
+        return;
+    undo_.valid = false;
+    if (undo_.full)
+    {
+        full_ = true;
+        return;
+    }
+    if (undo_.haveWhole)
+    {
+        std::swap(front_, undo_.whole);
+        return;
+    }
+    Cell *f = front_.At(1, 1);
+    for (auto it = undo_.cells.rbegin(); it != undo_.cells.rend(); ++it)
+        f[it->first] = it->second;
+}
+
+// Scrolls the terminal's rows [top, bottom] inside a DECSTBM region and
+// shifts front_ the same way, so the diff below only sends what the scroll
+// did not already put in place.
+void Screen::Scroll(std::string &out, const ScrollHint &h)
+{
+    const int cols = front_.Cols();
+    const int n = h.delta > 0 ? h.delta : -h.delta;
+
+    // Lines scrolled in take the current SGR background; reset it so they
+    // match the blank cells assumed below.
+    out += "\x1b[0m\x1b[";
+    AppendInt(out, h.top);
+    out.push_back(';');
+    AppendInt(out, h.bottom);
+    out += "r\x1b[";
+    AppendInt(out, n);
+    out.push_back(h.delta > 0 ? 'S' : 'T');
+    out += "\x1b[r";
+
+    auto row = [&](int r)
+    { return front_.At(r, 1); };
+    if (h.delta > 0)
+    {
+        for (int r = h.top; r + n <= h.bottom; ++r)
+            std::copy(row(r + n), row(r + n) + cols, row(r));
+        for (int r = h.bottom - n + 1; r <= h.bottom; ++r)
+            std::fill(row(r), row(r) + cols, Cell{});
+    }
+    else
+    {
+        for (int r = h.bottom; r - n >= h.top; --r)
+            std::copy(row(r - n), row(r - n) + cols, row(r));
+        for (int r = h.top; r < h.top + n && r <= h.bottom; ++r)
+            std::fill(row(r), row(r) + cols, Cell{});
+    }
+}
+
+void Screen::Present(std::string &out)
+{
+    const size_t start = out.size();
+    const int cols = back_.Cols(), rows = back_.Rows();
+
+    const Palette &pal = ActivePalette();
+    if (pal.Generation() != paletteGen_)
+    {
+        paletteGen_ = pal.Generation();
+        full_ = true;
+    }
+
+    undo_.cells.clear();
+    undo_.haveWhole = false;
+    undo_.full = full_;
+    undo_.valid = true;
+
+    const ScrollHint hint = back_.TakeScrollHint();
+    if (!full_ && hint.delta != 0 && hint.top >= 1 && hint.bottom <= rows &&
+        (hint.delta > 0 ? hint.delta : -hint.delta) < hint.bottom - hint.top + 1)
+    {
+        undo_.whole = front_;
+        undo_.haveWhole = true;
+        Scroll(out, hint);
+    }
+    const bool logCells = !full_ && !undo_.haveWhole;
+
+    // Terminal cursor and colours are unknown at the start of every frame.
+    int curRow = 0, curCol = 0;
+    SgrTracker sgr(pal);
+    Utf8Out glyphs{out};
+
+    for (int r = 1; r <= rows; ++r)
+    {
+        const Cell *b = back_.Row(r);
+        Cell *f = front_.At(r, 1);
+        for (int c = 1; c <= cols; ++c)
+        {
+            const Cell &cell = b[c - 1];
+            if (!full_ && cell == f[c - 1])
+                continue;
+
+            if (r != curRow || c != curCol)
+            {
+                out += "\x1b[";
+                if (r == curRow && c > curCol)
+                {
+                    AppendInt(out, c - curCol);
+                    out.push_back('C');
+                }
+                else
+                {
+                    AppendInt(out, r);
+                    out.push_back(';');
+                    AppendInt(out, c);
+                    out.push_back('H');
+                }
+            }
+            sgr.Apply(out, cell);
+            glyphs.Put(cell.ch);
+            if (logCells)
+                undo_.cells.emplace_back((uint32_t)((r - 1) * cols + (c - 1)), f[c - 1]);
+            f[c - 1] = cell;
+
+            curRow = r;
+            // Writing the last column leaves the cursor in a pending-wrap state.
+            curCol = (c == cols) ? 0 : c + 1;
+        }
+    }
+
+    if (sgr.Known())
+        out += "\x1b[0m";
+    full_ = false;
+    lastBytes_ = out.size() - start;
+}
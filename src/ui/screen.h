@@ -0,0 +1,166 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "theme.h"
+
+enum : uint8_t
+{
+    kAttrBold = 1 << 0,
+    kAttrUnderline = 1 << 1,
+};
+
+struct Cell
+{
+    char32_t ch = U' ';
+    ColorIndex fg = kColorDefault;
+    ColorIndex bg = kColorDefault;
+    uint8_t attr = 0;
+
+    bool operator==(const Cell &) const = default;
+};
+
+// Rows [top, bottom] of a frame repeat the previous frame's rows moved up
+// by `delta` (down when negative).
+struct ScrollHint
+{
+    int top = 0, bottom = 0, delta = 0;
+};
+
+// Row-major grid of cells. Coordinates are 1-based like the terminal's;
+// writes outside the grid are dropped.
+class CellGrid
+{
+public:
+    void Resize(int cols, int rows);
+    int Cols() const { return cols_; }
+    int Rows() const { return rows_; }
+
+    Cell *At(int row, int col)
+    {
+        if (row < 1 || row > rows_ || col < 1 || col > cols_)
+            return nullptr;
+        return &cells_[(size_t)(row - 1) * cols_ + (col - 1)];
+    }
+    const Cell *Row(int row) const { return &cells_[(size_t)(row - 1) * cols_]; }
+
+    void Fill(const Cell &c);
+
+    // Changes whenever every cell was reset (Resize, Fill), so retained
+    // drawings can tell they are gone.
+    uint64_t Epoch() const { return epoch_; }
+
+    // Lets Screen::Present() shift the rows with a terminal scroll instead
+    // of rewriting them. Only valid for the frame being drawn.
+    void HintScroll(int top, int bottom, int delta) { hint_ = {top, bottom, delta}; }
+    ScrollHint TakeScrollHint()
+    {
+        ScrollHint h = hint_;
+        hint_ = {};
+        return h;
+    }
+
+private:
+    int cols_ = 0, rows_ = 0;
+    std::vector<Cell> cells_;
+    ScrollHint hint_;
+    uint64_t epoch_ = 0;
+};
+
+// Drawing cursor for panels. Colours and attributes are set once and apply
+// to every following write, so panel text never carries escape sequences.
+class Pen
+{
+public:
+    explicit Pen(CellGrid &g) : g_(g) {}
+
+    Pen &Fg(ColorIndex c)
+    {
+        fg_ = c;
+        return *this;
+    }
+    Pen &Bg(ColorIndex c)
+    {
+        bg_ = c;
+        return *this;
+    }
+    Pen &Fg(ColorRole r) { return Fg(ToIndex(r)); }
+    Pen &Bg(ColorRole r) { return Bg(ToIndex(r)); }
+    Pen &Attr(uint8_t a)
+    {
+        attr_ = a;
+        return *this;
+    }
+    Pen &At(int row, int col)
+    {
+        row_ = row;
+        col_ = col;
+        return *this;
+    }
+
+    Pen &Text(std::wstring_view s);
+    Pen &Fill(char32_t ch, int count);
+    // Blanks the rest of the row up to and including `lastCol`.
+    Pen &ClearTo(int lastCol);
+
+    // Writes one glyph and advances; also makes a Pen an output for fmt.h.
+    void Put(char32_t ch)
+    {
+        if (Cell *c = g_.At(row_, col_))
+            *c = Cell{ch, fg_, bg_, attr_};
+        ++col_;
+    }
+
+    int Col() const { return col_; }
+
+private:
+
+    CellGrid &g_;
+    ColorIndex fg_ = kColorDefault, bg_ = kColorDefault;
+    uint8_t attr_ = 0;
+    int row_ = 1, col_ = 1;
+};
+
+// Double-buffered screen: panels draw into Back(), Present() compares it to
+// what the terminal already shows and emits only the cells that changed.
+class Screen
+{
+public:
+    // Returns true when the size changed; both buffers are then cleared.
+    bool Resize(int cols, int rows);
+    CellGrid &Back() { return back_; }
+
+    // Forces the next Present() to repaint every cell. Also happens on its
+    // own when the active palette is recompiled.
+    void Invalidate() { full_ = true; }
+
+    // Appends cursor moves, SGR and UTF-8 glyphs for changed cells to `out`.
+    // A scroll hint on the back buffer becomes DECSTBM + SU/SD first.
+    void Present(std::string &out);
+
+    // Bytes the last Present() appended.
+    size_t LastFrameBytes() const { return lastBytes_; }
+
+    // Forgets the last Present() as if its output never reached the
+    // terminal, for when that output was dropped unwritten. One step only.
+    void Rollback();
+
+private:
+    void Scroll(std::string &out, const ScrollHint &h);
+
+    CellGrid back_, front_;
+    // What the last Present() overwrote in front_: single cells, or all of
+    // it when the frame scrolled.
+    struct
+    {
+        std::vector<std::pair<uint32_t, Cell>> cells;
+        CellGrid whole;
+        bool haveWhole = false, full = false, valid = false;
+    } undo_;
+    bool full_ = true;
+    unsigned paletteGen_ = 0;
+    size_t lastBytes_ = 0;
+};
@@ -1,13 +1,28 @@
 #include "ui.h"
-#include "util.h"
 #include "theme.h"
+#include "fmt.h"
+#include "proc_view.h"
+#include "row_cache.h"
+#include "ui_graph.h"
+#include "compositor.h"
+#include "render_pool.h"
 
-#include <sstream>
-#include <iomanip>
 #include <algorithm>
 #include <cmath>
-#include <windows.h>
-#include <winreg.h>
+#include <iterator>
+
+static ProcView g_procView;
+static RowCache g_rowCache;
+static Compositor g_layers;
+static RenderPool g_pool;
+
+// Panels are drawn on g_pool once the console has at least minCells cells.
+// Off until SetParallelRender() turns it on.
+static struct
+{
+    int workers = 0;
+    int minCells = 0;
+} g_parallel;
 
 static constexpr wchar_t H = L'\u2500';
 static constexpr wchar_t V = L'\u2502';
@@ -16,52 +31,21 @@ static constexpr wchar_t TR = L'\u2510';
 static constexpr wchar_t BL = L'\u2514';
 static constexpr wchar_t BR = L'\u2518';
 
-static void put(std::wstring &f, short row, short col, std::wstring_view s)
-{
-    std::wstringstream ss;
-    ss << L"\x1b[" << row << L";" << col << L"H" << s;
-    f += ss.str();
-}
+static constexpr int kCoreBarW = 12, kCoreColGap = 18;
 
-static void put_eol_bg(std::wstring &f, short row, short col, const std::wstring &s, const Rgb &bg)
-{
-    const std::wstring rst = RST();
-    std::wstring body = s;
-    if (body.size() >= rst.size() && body.rfind(rst) == body.size() - rst.size())
-        body.erase(body.size() - rst.size());
-
-    std::wstringstream ss;
-    ss << L"\x1b[" << row << L';' << col << L'H'
-       << bg24(bg) << body
-       << bg24(bg) << L"\x1b[K"
-       << RST();
-    f += ss.str();
-}
-
-static void FillRectBG(std::wstring &f, short top, short left, short height, short width, const Rgb &color)
+static void FillRectBG(CellGrid &g, short top, short left, short height, short width, ColorRole color)
 {
     if (height <= 0 || width <= 0)
         return;
-    const std::wstring row = bg24(color) + std::wstring(width, L' ') + RST();
+    const Cell blank{U' ', kColorDefault, ToIndex(color)};
     for (short r = 0; r < height; ++r)
-        put(f, (short)(top + r), left, row);
+        for (short c = 0; c < width; ++c)
+            if (Cell *cell = g.At(top + r, left + c))
+                *cell = blank;
 }
 
-static std::wstring apply_bg(std::wstring s, const Rgb &bg)
-{
-    const std::wstring rst = RST();
-    const std::wstring b = bg24(bg);
-    size_t pos = 0;
-    while ((pos = s.find(rst, pos)) != std::wstring::npos)
-    {
-        s.insert(pos + rst.size(), b);
-        pos += (size_t)rst.size() + (size_t)b.size();
-    }
-    return b + s + RST();
-}
-
-static void Box(std::wstring &f, short top, short left, short height, short width,
-                std::wstring title, const Rgb &bgColor, const Rgb *titleColor = nullptr)
+// Horizontal edge of a box, title gap included.
+static std::wstring BoxRule(short width, const std::wstring &title)
 {
     std::wstring line(width, H);
     if (!title.empty() && (int)title.size() + 2 < width)
@@ -70,6 +54,17 @@ static void Box(std::wstring &f, short top, short left, short height, short widt
         for (int i = 1, j = 0; i < width - 1 && j < (int)deco.size(); ++i)
             line[i] = deco[j++];
     }
+    return line;
+}
+
+static void Box(CellGrid &g, short top, short left, short height, short width,
+                std::wstring title, ColorRole bgColor, ColorRole titleColor = ColorRole::Hdr)
+{
+    // Narrow consoles leave no room for the right-hand panel.
+    if (width < 2 || height < 2)
+        return;
+
+    const std::wstring line = BoxRule(width, title);
 
     std::wstring topLine, mid, bottomLine;
     topLine.push_back(TL);
@@ -82,56 +77,109 @@ static void Box(std::wstring &f, short top, short left, short height, short widt
     bottomLine.append(line.begin() + 1, line.begin() + width - 1);
     bottomLine.push_back(BR);
 
-    const std::wstring frameCol = fg24(ActiveTheme().frame);
-    const std::wstring bg = bg24(bgColor);
-
-    put(f, top, left, bg + frameCol + topLine + RST());
+    Pen p(g);
+    p.Bg(bgColor).Fg(ColorRole::Frame);
+    p.At(top, left).Text(topLine);
     for (short r = top + 1; r <= top + height - 2; ++r)
-        put(f, r, left, bg + frameCol + mid + RST());
-    put(f, (short)(top + height - 1), left, bg + frameCol + bottomLine + RST());
+        p.At(r, left).Text(mid);
+    p.At(top + height - 1, left).Text(bottomLine);
 
     if (!title.empty())
-    {
-        const std::wstring tcol = titleColor ? fg24(*titleColor) : col_hdr();
-        put(f, top, (short)(left + 2), bg + tcol + title + RST());
-    }
+        p.At(top, left + 2).Fg(titleColor).Attr(kAttrBold).Text(title);
 }
 
-static void FilledBox(std::wstring &f, short top, short left, short height, short width,
-                      std::wstring title, const Rgb &innerBg, const Rgb *titleColor = nullptr)
+static void FilledBox(CellGrid &g, short top, short left, short height, short width,
+                      std::wstring title, ColorRole innerBg, ColorRole titleColor = ColorRole::Hdr)
 {
-    FillRectBG(f, (short)(top + 1), (short)(left + 1), (short)(height - 2), (short)(width - 2), innerBg);
-    Box(f, top, left, height, width, std::move(title), innerBg, titleColor);
+    FillRectBG(g, (short)(top + 1), (short)(left + 1), (short)(height - 2), (short)(width - 2), innerBg);
+    Box(g, top, left, height, width, std::move(title), innerBg, titleColor);
 }
 
-static void ProgressBar(std::wstring &f, short row, short col, int width, double percent)
+static void ProgressBar(CellGrid &g, short row, short col, int width, double percent)
 {
     if (width <= 0)
         return;
     percent = std::clamp(percent, 0.0, 100.0);
     int filled = (int)std::round((percent / 100.0) * width);
-    const auto &t = ActiveTheme();
-    std::wstringstream ss;
-    ss << L"\x1b[" << row << L";" << col << L"H" << bg24(t.meter_bg) << std::wstring(width, L' ') << RST();
-    ss << L"\x1b[" << row << L";" << col << L"H";
+    FillRectBG(g, row, col, 1, (short)width, ColorRole::MeterBg);
     for (int i = 0; i < filled; ++i)
+        if (Cell *cell = g.At(row, col + i))
+            *cell = Cell{U' ', kColorDefault, Palette::Gradient(i, filled)};
+}
+
+// Column widths from kProcColumns for a row `innerWidth` cells wide.
+static void LayoutColumns(TableLayout &T, int innerWidth)
+{
+    auto flexLeft = [&](uint32_t columns)
     {
-        double k = (filled <= 1) ? 1.0 : (double)i / (filled - 1);
-        int r = (int)std::round(t.barLo.r + (t.barHi.r - t.barLo.r) * k);
-        int g = (int)std::round(t.barLo.g + (t.barHi.g - t.barLo.g) * k);
-        int b = (int)std::round(t.barLo.b + (t.barHi.b - t.barLo.b) * k);
-        ss << bg24(r, g, b) << L' ';
+        int left = innerWidth + 1, mins = 0;
+        for (const ProcColumn &c : kProcColumns)
+        {
+            if (!(columns & ColumnBit(c.key)))
+                continue;
+            left -= c.policy == ColWidth::Fixed ? c.width + 1 : 1;
+            if (c.policy != ColWidth::Fixed)
+                mins += c.width;
+        }
+        return std::pair{left, left >= mins};
+    };
+
+    T.columns = kAllProcColumns;
+    auto [flex, fits] = flexLeft(T.columns);
+    if (!fits)
+    {
+        T.columns &= ~kOptionalProcColumns;
+        flex = flexLeft(T.columns).first;
+    }
+    flex = std::max(0, flex);
+
+    int shares = 0, lastFlex = -1;
+    for (int i = 0; i < kProcColCount; ++i)
+    {
+        const ProcColumn &c = kProcColumns[i];
+        T.colW[i] = 0;
+        if (!(T.columns & ColumnBit(c.key)))
+            continue;
+        if (c.policy == ColWidth::Fixed)
+            T.colW[i] = c.width;
+        else
+        {
+            shares += c.share;
+            lastFlex = i;
+        }
+    }
+
+    int used = 0;
+    for (int i = 0; i < kProcColCount; ++i)
+    {
+        const ProcColumn &c = kProcColumns[i];
+        if (c.policy == ColWidth::Fixed || !(T.columns & ColumnBit(c.key)))
+            continue;
+        const int want = i == lastFlex ? flex - used : flex * c.share / shares;
+        T.colW[i] = (short)std::max<int>(c.width, want);
+        used += T.colW[i];
     }
-    ss << RST();
-    f += ss.str();
+
+    // Minimums that do not fit come off the right-most flex columns: first
+    // down to their minimum, then to nothing.
+    int over = used - flex;
+    for (int floor = 1; floor >= 0 && over > 0; --floor)
+        for (int i = lastFlex; i >= 0 && over > 0; --i)
+        {
+            const ProcColumn &c = kProcColumns[i];
+            if (c.policy == ColWidth::Fixed || !(T.columns & ColumnBit(c.key)))
+                continue;
+            const int cut = std::min(over, T.colW[i] - (floor ? c.width : 0));
+            T.colW[i] = (short)(T.colW[i] - cut);
+            over -= cut;
+        }
 }
 
-Layout ComputeLayout()
+Layout ComputeLayout(short cols, short rows)
 {
-    COORD s = GetConsoleSize();
     Layout L;
-    L.cols = s.X;
-    L.rows = s.Y;
+    L.cols = cols;
+    L.rows = rows;
     L.left = 2;
     L.top = 1;
     L.right = L.cols - 2;
@@ -142,125 +190,121 @@ Layout ComputeLayout()
     L.panelWidth = (short)((inner - GAP) / 2);
     if (L.panelWidth < 40)
         L.panelWidth = (short)(L.cols - 4);
+    L.graphHeight = (short)(L.rows >= 40 ? 8 : 0);
+
+    const short boxHeight = 8;
+    const short wLeft = L.panelWidth;
+    const short wRight = (short)(inner - GAP - wLeft);
+    L.cpu = {1, L.left, boxHeight, wLeft};
+    L.mem = {1, (short)(L.left + wLeft + GAP), boxHeight, wRight};
+    if (L.graphHeight > 0)
+    {
+        L.cpuGraph = {(short)(1 + boxHeight), L.cpu.left, L.graphHeight, wLeft};
+        if (wRight >= 10)
+            L.memGraph = {(short)(1 + boxHeight), L.mem.left, L.graphHeight, wRight};
+    }
+    L.coreCols = (short)std::max(1, ((int)wLeft - 6) / kCoreColGap);
+
+    TableLayout &T = L.table;
+    const short tableTop = (short)(1 + boxHeight + L.graphHeight + 1);
+    T.box = {tableTop, 2, (short)(L.rows - tableTop - 1), (short)(L.cols - 4)};
+    T.headerRow = (short)(tableTop + 2);
+    T.bodyTop = (short)(T.headerRow + 1);
+    T.innerLeft = 3;
+    const int innerWidth = T.box.width - 2;
+    T.innerRight = (short)(T.innerLeft + innerWidth - 1);
+    // The body ends one row above the bottom border.
+    T.pageRows = std::max(1, (T.box.top + T.box.height - 1) - T.bodyTop);
+
+    LayoutColumns(T, innerWidth);
     return L;
 }
 
-TableMetrics ComputeTableMetrics(const Layout &L)
+static void HeaderLine(Pen &p, const TableLayout &T)
 {
-    const int boxHeight = 8;
-    const int tableTop = 1 + boxHeight + 1;
-    const int pageRows = std::max(1, (int)L.rows - tableTop - 3);
-    return {tableTop, pageRows};
+    p.Fg(ColorRole::Hdr);
+    bool first = true;
+    for (const ProcColumn &c : kProcColumns)
+    {
+        if (!(T.columns & ColumnBit(c.key)))
+            continue;
+        if (!first)
+            p.Put(U' ');
+        first = false;
+        const int w = T.colW[(int)c.key];
+        const std::wstring_view title = c.title;
+        if (c.right)
+            FmtRepeat(p, U' ', w - (int)title.size());
+        FmtPad(p, title, c.right ? std::min<int>(w, (int)title.size()) : w);
+    }
 }
 
-static std::wstring Ellipsis(std::wstring s, size_t w)
+// Blanks part of a box's inside the way Box() leaves it, so contents can be
+// drawn again without touching the frame.
+static void ClearInside(CellGrid &g, int top, int left, int height, int width, ColorRole bg)
 {
-    if (w == 0)
-        return L"";
-    if (s.size() <= w)
-        return PadRight(std::move(s), w);
-    if (w <= 1)
-        return s.substr(0, w);
-    return s.substr(0, w - 1) + L"…";
+    Pen p(g);
+    p.Bg(bg).Fg(ColorRole::Frame);
+    for (int r = top; r < top + height; ++r)
+        p.At(r, left).Fill(U' ', width);
 }
 
-static std::wstring MiddleEllipsis(const std::wstring &s, size_t w)
-{
-    if (w == 0)
-        return L"";
-    if (s.size() <= w)
-        return PadRight(s, w);
-    if (w <= 1)
-        return s.substr(0, w);
-    size_t left = (w - 1) / 2;
-    size_t right = (w - 1) - left;
-    return s.substr(0, left) + L"…" + s.substr(s.size() - right);
-}
-
-static std::wstring HeaderLine(int pidW, int nameW, int cmdW, int thW, int userW, int memW, int cpuW)
-{
-    std::wstringstream hdr;
-    hdr << col_hdr()
-        << std::setw(pidW) << L"Pid" << L" "
-        << PadRight(L"Program", nameW) << L" ";
-    if (cmdW > 0)
-        hdr << PadRight(L"Command", cmdW) << L" ";
-    hdr << PadRight(L"Threads", thW) << L" "
-        << PadRight(L"User", userW) << L" "
-        << PadRight(L"MemB", memW) << L" "
-        << PadRight(L"Cpu%", cpuW);
-    return hdr.str();
+static void ClearInside(CellGrid &g, const Rect &r, ColorRole bg)
+{
+    ClearInside(g, r.top + 1, r.left + 1, r.height - 2, r.width - 2, bg);
 }
 
-std::wstring BuildFrame(
-    const Layout &L,
-    double cpuUsage,
-    const MemInfo &mem,
-    const std::vector<ProcInfo> &procs,
-    int hz,
-    const std::vector<double> &perCoreCpu,
-    const std::wstring &netLine,
-    const std::wstring &diskLine,
-    const std::wstring &netSpark,
-    const std::wstring &diskSpark,
-    int procSort,
-    int procScroll,
-    int selectedIndex,
-    int totalCount)
+// Panel-coloured margin around the dark background everything sits on.
+class Backdrop : public Widget
 {
-    (void)totalCount;
-
-    std::wstring f;
-    f.reserve(L.rows * (L.cols + 8));
-
-    f += bg24(ActiveTheme().bg) + L"\x1b[2J\x1b[H" + RST();
-
-    FillRectBG(f, 1, 1, L.rows, (short)(L.cols), ActiveTheme().panel);
-    FillRectBG(f, 2, 2, (short)(L.rows - 2), (short)(L.cols - 1), ActiveTheme().bg);
+protected:
+    void Render(CellGrid &g, bool) override
+    {
+        FillRectBG(g, rect_.top, rect_.left, rect_.height, rect_.width, ColorRole::Panel);
+        FillRectBG(g, 2, 2, (short)(rect_.height - 2), (short)(rect_.width - 1), ColorRole::Bg);
+    }
+};
 
-    wchar_t cpuName[256] = L"CPU";
-    DWORD sz = sizeof(cpuName);
-    RegGetValueW(HKEY_LOCAL_MACHINE,
-                 L"HARDWARE\\DESCRIPTION\\System\\CentralProcessor\\0",
-                 L"ProcessorNameString",
-                 RRF_RT_REG_SZ, nullptr, &cpuName, &sz);
-    ULONGLONG ms = GetTickCount64();
-    int days = (int)(ms / (1000ull * 60 * 60 * 24));
-    int hrs = (int)((ms / (1000ull * 60 * 60)) % 24);
+class CpuPanel : public Widget
+{
+public:
+    void Set(double usage, int hz, const std::vector<double> &perCore, short coreCols)
+    {
+        Update(usage_, usage);
+        Update(hz_, hz);
+        Update(perCore_, perCore);
+        Update(coreCols_, coreCols);
+    }
 
-    std::wstringstream title;
-    title << L"winbtop — " << cpuName << L" — Uptime: "
-          << days << L"d " << hrs << L"h  — Q quit · F1 cpu% · F2 mem · F3 pid · F6 name · F5 Hz · Esc menu · H help";
-    SetTitle(title.str());
+protected:
+    void Render(CellGrid &g, bool full) override
+    {
+        const ColorRole bg = ColorRole::Overlay;
+        const short row = rect_.top, col1 = rect_.left, w = rect_.width;
+        if (full)
+            FilledBox(g, row, col1, rect_.height, w, L" CPU ", bg, ColorRole::BoxCpu);
+        else
+            ClearInside(g, rect_, bg);
 
-    short row = 1;
-    short col1 = L.left;
-    const int GAP = 1;
-    const int inner = (L.right - L.left + 1);
+        Pen p(g);
+        p.Bg(bg).Fg(ColorRole::Text);
 
-    short wLeft = L.panelWidth;
-    short wRight = (short)(inner - GAP - wLeft);
-    short col2 = (short)(col1 + wLeft + GAP);
+        p.At(row + 2, col1 + 2).Text(L"Usage: ");
+        FmtFixed(p, usage_, 1);
+        p.Text(L"%   (");
+        FmtUInt(p, (uint64_t)std::max(0, hz_));
+        p.Text(L" Hz)");
+        ProgressBar(g, row + 3, col1 + 2, (int)w - 4, usage_);
 
-    const Rgb innerCpuBg = ActiveTheme().overlay;
-    FilledBox(f, row, col1, 8, wLeft, L" CPU ", innerCpuBg, &ActiveTheme().box_cpu);
-    {
-        std::wstringstream ss;
-        ss << L"Usage: " << std::fixed << std::setprecision(1) << cpuUsage << L"%   (" << hz << L" Hz)";
-        put(f, row + 2, col1 + 2, apply_bg(col_text() + ss.str(), innerCpuBg));
-        ProgressBar(f, row + 3, col1 + 2, (int)wLeft - 4, cpuUsage);
-
-        const int barW = 12, colGap = 18;
-        int perRow = std::max(1, ((int)wLeft - 6) / colGap);
         short r = (short)(row + 5), c = (short)(col1 + 2);
-        for (size_t i = 0; i < perCoreCpu.size(); ++i)
+        for (size_t i = 0; i < perCore_.size(); ++i)
         {
-            std::wstringstream lab;
-            lab << L"C" << i << L": ";
-            put(f, r, c, apply_bg(col_text() + lab.str(), innerCpuBg));
-            ProgressBar(f, r, (short)(c + 4), barW, perCoreCpu[i]);
-            c = (short)(c + colGap);
-            if (((i + 1) % perRow) == 0)
+            p.At(r, c).Text(L"C");
+            FmtUInt(p, i);
+            p.Text(L": ");
+            ProgressBar(g, r, (short)(c + 4), kCoreBarW, perCore_[i]);
+            c = (short)(c + kCoreColGap);
+            if (((i + 1) % coreCols_) == 0)
             {
                 r++;
                 c = (short)(col1 + 2);
@@ -270,211 +314,515 @@ std::wstring BuildFrame(
         }
     }
 
-    const Rgb innerMemBg = ActiveTheme().overlay;
-    FilledBox(f, row, col2, 8, wRight, L" Memory ", innerMemBg, &ActiveTheme().box_mem);
+private:
+    double usage_ = 0;
+    int hz_ = 0;
+    std::vector<double> perCore_;
+    short coreCols_ = 1;
+};
+
+static const wchar_t *const kMemoryTitle = L" Memory ";
+
+// Memory box frame and the total/used/avail block; the disk and net lines
+// at the bottom of the box are their own widget.
+class MemoryPanel : public Widget
+{
+public:
+    void Set(const MemInfo &m)
+    {
+        Update(total_, m.total);
+        Update(used_, m.used);
+        Update(avail_, m.avail);
+        Update(percent_, m.percent);
+    }
+
+protected:
+    void Render(CellGrid &g, bool full) override
+    {
+        const ColorRole bg = ColorRole::Overlay;
+        const short row = rect_.top, col2 = rect_.left;
+        if (rect_.width < 2)
+            return;
+        if (full)
+            FilledBox(g, row, col2, rect_.height, rect_.width, kMemoryTitle, bg, ColorRole::BoxMem);
+        else
+            ClearInside(g, row + 1, col2 + 1, 5, rect_.width - 2, bg);
+
+        Pen p(g);
+        p.Bg(bg).Fg(ColorRole::Text);
+        p.At(row + 2, col2 + 2).Text(L"Total: ");
+        FmtBytes(p, total_);
+        p.At(row + 3, col2 + 2).Text(L"Used : ");
+        FmtBytes(p, used_);
+        p.At(row + 4, col2 + 2).Text(L"Avail: ");
+        FmtBytes(p, avail_);
+        ProgressBar(g, row + 5, col2 + 2, (int)rect_.width - 4, percent_);
+    }
+
+private:
+    ULONGLONG total_ = 0, used_ = 0, avail_ = 0;
+    double percent_ = 0;
+};
+
+// Disk and net throughput with their sparklines. The net line sits on the
+// memory box's bottom border, so clearing it means redrawing that border.
+class DiskNetLine : public Widget
+{
+public:
+    void Set(const std::wstring &diskLine, const std::wstring &diskSpark,
+             const std::wstring &netLine, const std::wstring &netSpark)
     {
-        put(f, row + 2, col2 + 2, apply_bg(col_text() + L"Total: " + FormatBytesULONGLONG(mem.total), innerMemBg));
-        put(f, row + 3, col2 + 2, apply_bg(col_text() + L"Used : " + FormatBytesULONGLONG(mem.used), innerMemBg));
-        put(f, row + 4, col2 + 2, apply_bg(col_text() + L"Avail: " + FormatBytesULONGLONG(mem.avail), innerMemBg));
-        ProgressBar(f, row + 5, col2 + 2, (int)wRight - 4, mem.percent);
+        Update(diskLine_, diskLine);
+        Update(diskSpark_, diskSpark);
+        Update(netLine_, netLine);
+        Update(netSpark_, netSpark);
+    }
 
-        auto lineWithSpark = [&](const std::wstring &line, const std::wstring &spark, int width)
+protected:
+    void Render(CellGrid &g, bool) override
+    {
+        const ColorRole bg = ColorRole::Overlay;
+        const short row = rect_.top, col2 = rect_.left;
+        if (rect_.width < 2)
+            return;
+        ClearInside(g, row, col2 + 1, 1, rect_.width - 2, bg);
+
+        const std::wstring rule = BoxRule(rect_.width, kMemoryTitle);
+        Pen p(g);
+        p.Bg(bg).Fg(ColorRole::Frame).At(row + 1, col2).Put(BL);
+        p.Text(std::wstring_view(rule).substr(1, rect_.width - 2)).Put(BR);
+        p.Fg(ColorRole::Text);
+
+        auto lineWithSpark = [&](short r, const std::wstring &line, const std::wstring &spark, int width)
         {
+            p.At(r, col2 + 2);
             if (width <= 12 || spark.empty())
-                return line;
-            int maxText = std::max(0, width - 2 - (int)spark.size());
-            std::wstring text = line;
-            if ((int)text.size() > maxText)
             {
-                text = text.substr(0, std::max(0, maxText - 1));
-                text.push_back(L'…');
+                p.Text(line);
+                return;
             }
-            return text + L"  " + spark;
+            int maxText = std::max(0, width - 2 - (int)spark.size());
+            if ((int)line.size() > maxText)
+                FmtEllipsis(p, line, maxText);
+            else
+                p.Text(line);
+            p.Text(L"  ").Text(spark);
         };
 
-        const int innerWidth = (int)wRight - 4;
-        std::wstring diskLn = lineWithSpark(diskLine, diskSpark, innerWidth);
-        std::wstring netLn = lineWithSpark(netLine, netSpark, innerWidth);
-
-        put(f, row + 6, col2 + 2, apply_bg(col_text() + diskLn, innerMemBg));
-        put(f, row + 7, col2 + 2, apply_bg(col_text() + netLn, innerMemBg));
+        const int innerWidth = (int)rect_.width - 4;
+        lineWithSpark(row, diskLine_, diskSpark_, innerWidth);
+        lineWithSpark(row + 1, netLine_, netSpark_, innerWidth);
     }
 
-    auto tm = ComputeTableMetrics(L);
-    short tableTop = (short)tm.tableTop;
-    const Rgb innerProcBg = ActiveTheme().overlay;
-    FilledBox(f, tableTop, 2, (short)(L.rows - tableTop - 1), (short)(L.cols - 4), L" Top processes ", innerProcBg, &ActiveTheme().box_proc);
-    {
-        const short innerLeftCol = 3;
-        short innerRow = tableTop + 2;
+private:
+    std::wstring diskLine_, diskSpark_, netLine_, netSpark_;
+};
 
-        const int pidW = 5, thW = 7, memW = 11, cpuW = 6;
-        const int boxWidth = (L.cols - 4);
-        const int innerWidth = boxWidth - 2;
-        const int maxRows = tm.pageRows;
+// Boxed braille history graph; the graph itself only advances by the
+// samples the ring gained since the last draw, and a new sample moves the
+// cells already in the grid over instead of writing them all again.
+class HistoryGraph : public Widget
+{
+public:
+    HistoryGraph(const wchar_t *title, ColorRole titleColor) : title_(title), titleColor_(titleColor) {}
 
-        const int nameW_min = 10, userW_min = 10, cmdW_min = 15;
-        const int seps_no_cmd = 5, seps_cmd = 6;
-        const int fixed = pidW + thW + memW + cpuW;
+    void Set(const Ring<double> &hist)
+    {
+        hist_ = &hist;
+        Update(pushed_, hist.pushed());
+    }
 
-        const int flex_no_cmd = innerWidth - fixed - seps_no_cmd;
-        const int flex_cmd = innerWidth - fixed - seps_cmd;
-        const bool canShowCmd = (flex_cmd >= (nameW_min + userW_min + cmdW_min));
+protected:
+    void Render(CellGrid &g, bool full) override
+    {
+        const ColorRole bg = ColorRole::Overlay;
+        const short top = rect_.top, left = rect_.left;
+        const bool resized = graph_.Resize(rect_.width - 4, rect_.height - 2);
+        const GraphChange ch = graph_.Sync(*hist_);
+        const int rows = graph_.Rows(), width = graph_.Width();
+
+        int from = 0;
+        if (full || resized || ch.fresh >= width || !g.At(top + rows, left + 1 + width))
+        {
+            if (full)
+                FilledBox(g, top, left, rect_.height, rect_.width, title_, bg, titleColor_);
+            else
+                ClearInside(g, rect_, bg);
+        }
+        else
+        {
+            from = width - ch.fresh;
+            if (ch.shifted > 0)
+                for (int r = 0; r < rows; ++r)
+                {
+                    Cell *row = g.At(top + 1 + r, left + 2);
+                    std::copy(row + ch.shifted, row + width, row);
+                }
+        }
 
-        std::vector<ProcInfo> sorted = procs;
-        switch (procSort)
+        Pen p(g);
+        p.Bg(bg);
+        for (int r = 0; r < rows; ++r)
         {
-        case 1:
-            std::sort(sorted.begin(), sorted.end(), [](auto &a, auto &b)
-                      { return a.cpu_percent > b.cpu_percent; });
-            break;
-        case 2:
-            std::sort(sorted.begin(), sorted.end(), [](auto &a, auto &b)
-                      { return a.pid < b.pid; });
-            break;
-        case 3:
-            std::sort(sorted.begin(), sorted.end(), [](auto &a, auto &b)
-                      { return a.name < b.name; });
-            break;
-        default:
-            std::sort(sorted.begin(), sorted.end(), [](auto &a, auto &b)
-                      { return a.workingSet > b.workingSet; });
-            break;
+            // Hotter colours towards the top of the graph.
+            p.Fg(Palette::Gradient(rows - 1 - r, rows)).At(top + 1 + r, left + 2 + from);
+            for (int c = from; c < width; ++c)
+                p.Put(graph_.At(r, c));
         }
+    }
 
-        int maxScroll = std::max(0, (int)sorted.size() - maxRows);
-        int first = std::clamp(procScroll, 0, maxScroll);
-        int sel = selectedIndex;
+private:
+    const wchar_t *title_;
+    ColorRole titleColor_;
+    BrailleGraph graph_;
+    const Ring<double> *hist_ = nullptr;
+    unsigned long long pushed_ = 0;
+};
 
-        auto memCol = fg24(ActiveTheme().barHi);
+class ProcessTable : public Widget
+{
+public:
+    void Set(const TableLayout &T, const std::vector<ProcInfo> &procs, unsigned long long generation,
+             int procSort, int procScroll, int selectedIndex)
+    {
+        T_ = &T;
+        procs_ = &procs;
+        Update(generation_, generation);
+        Update(count_, procs.size());
+        Update(sort_, procSort);
+        Update(first_, std::clamp(procScroll, 0, std::max(0, (int)procs.size() - T.pageRows)));
+        Update(sel_, selectedIndex);
+    }
 
-        if (!canShowCmd)
-        {
-            int flex = std::max(0, flex_no_cmd);
-            int nameW = std::max(nameW_min, flex / 2);
-            int userW = std::max(userW_min, flex - nameW);
-            if (nameW + userW > flex)
-                userW = std::max(0, flex - nameW);
-
-            put_eol_bg(f, innerRow++, innerLeftCol,
-                       apply_bg(HeaderLine(pidW, nameW, 0, thW, userW, memW, cpuW), innerProcBg),
-                       innerProcBg);
-
-            int drawn = 0;
-            for (int i = first; i < (int)sorted.size() && drawn < maxRows; ++i, ++drawn)
-            {
-                const auto &p = sorted[i];
+    // Render() in three steps, so the rows can be drawn alongside other
+    // widgets: Prepare() draws the box and header and sorts the view, and
+    // returns how many bands (at most `bands`) the rows are split into;
+    // DrawBand() draws one of them and may run on any thread; Finish()
+    // runs after the last band.
+    int Prepare(CellGrid &g, bool full, int bands);
+    void DrawBand(CellGrid &g, int band);
+    void Finish(CellGrid &g);
+
+protected:
+    void Render(CellGrid &g, bool full) override;
+
+private:
+    ProcRowKey RowKey(const ProcInfo &p, int i, unsigned paletteGen) const;
+    // Draws view rows [from, to). Without `store`, cache misses are only
+    // flagged in missed_ and stored later by the caller.
+    void DrawRows(CellGrid &g, int from, int to, unsigned paletteGen, bool store);
+
+    const TableLayout *T_ = nullptr;
+    const std::vector<ProcInfo> *procs_ = nullptr;
+    unsigned long long generation_ = 0;
+    size_t count_ = 0;
+    int sort_ = 0, first_ = 0, sel_ = -1;
+    // Set by Prepare() for the bands and Finish().
+    int rowFirst_ = 0, rowCount_ = 0, bands_ = 1;
+    unsigned paletteGen_ = 0;
+    std::vector<uint8_t> missed_;
+
+    // Where the body was last drawn and from which row, so a scroll can be
+    // handed to Screen as a hint.
+    struct
+    {
+        int first = -1, top = 0, bottom = 0;
+    } scrolled_;
+};
 
-                bool selected = (i == sel);
+ProcRowKey ProcessTable::RowKey(const ProcInfo &p, int i, unsigned paletteGen) const
+{
+    const TableLayout &T = *T_;
+    ProcRowKey key{p.pid, p.threads, p.name, p.user, p.cmdline, p.memText, p.cpuText, p.load};
+    std::copy(std::begin(T.colW), std::end(T.colW), key.colW);
+    key.width = (short)std::max(0, T.innerRight - T.innerLeft + 1);
+    key.selected = i == sel_;
+    key.paletteGen = paletteGen;
+    return key;
+}
 
-                if (selected)
-                {
-                    std::wstringstream s;
-                    s << std::setw(pidW) << p.pid << L" "
-                      << Ellipsis(p.name, nameW) << L" "
-                      << std::setw(thW) << p.threads << L" "
-                      << Ellipsis(p.user, userW) << L" "
-                      << PadRight(FormatBytesULONGLONG((ULONGLONG)p.workingSet), memW) << L" "
-                      << std::setw(cpuW) << std::fixed << std::setprecision(1) << p.cpu_percent;
-                    put_eol_bg(f, innerRow++, innerLeftCol, fg24(ActiveTheme().sel_fg) + s.str(), ActiveTheme().sel_bg);
-                    continue;
-                }
+void ProcessTable::DrawRows(CellGrid &g, int from, int to, unsigned paletteGen, bool store)
+{
+    const TableLayout &T = *T_;
+    const ColorRole innerProcBg = ColorRole::Overlay;
+    const ProcRowFormatter plain = ProcRowFormatterFor(T.columns, false);
 
-                std::wstringstream ln;
-                ln << col_hdr() << std::setw(pidW) << p.pid << RST() << L" "
-                   << col_text() << Ellipsis(p.name, nameW) << RST() << L" "
-                   << col_hdr() << std::setw(thW) << p.threads << RST() << L" "
-                   << col_dim() << Ellipsis(p.user, userW) << RST() << L" "
-                   << memCol << PadRight(FormatBytesULONGLONG((ULONGLONG)p.workingSet), memW) << RST() << L" ";
-                const auto col = (p.cpu_percent > 80) ? col_crit() : (p.cpu_percent > 50) ? col_warn()
-                                                                                          : col_ok();
-                ln << col << std::setw(cpuW) << std::fixed << std::setprecision(1) << p.cpu_percent << RST();
-                put_eol_bg(f, innerRow++, innerLeftCol, apply_bg(ln.str(), innerProcBg), innerProcBg);
-            }
+    Pen pen(g);
+    int innerRow = T.bodyTop + (from - g_procView.First());
+    for (int i = from; i < to; ++i)
+    {
+        const auto &p = g_procView.Row(i);
+        const bool selected = (i == sel_);
+
+        const ProcRowKey key = RowKey(p, i, paletteGen);
+        // A console too narrow for the table has no row to cache.
+        Cell *rowCells = key.width > 0 ? g.At(innerRow, T.innerLeft) : nullptr;
+        if (rowCells && g_rowCache.Fetch(key, rowCells))
+        {
+            ++innerRow;
+            continue;
         }
+
+        // The selected row is drawn in one colour on the selection background.
+        pen.Bg(selected ? ColorRole::SelBg : innerProcBg).At(innerRow++, T.innerLeft);
+        (selected ? ProcRowFormatterFor(T.columns, true) : plain)(pen, p, T.colW);
+        pen.ClearTo(T.innerRight);
+        if (!rowCells)
+            continue;
+        if (store)
+            g_rowCache.Store(key, rowCells);
         else
-        {
-            int flex = std::max(0, flex_cmd);
-            int nameW = std::max(nameW_min, flex / 5);
-            int cmdW = std::max(cmdW_min, (flex * 3) / 5);
-            int userW = std::max(userW_min, flex - nameW - cmdW);
+            missed_[i - g_procView.First()] = 1;
+    }
+}
 
-            int over = nameW + cmdW + userW - flex;
-            if (over > 0)
-            {
-                int cut = std::min(over, userW - userW_min);
-                userW -= cut;
-                over -= cut;
-            }
-            if (over > 0)
+int ProcessTable::Prepare(CellGrid &g, bool full, int bands)
+{
+    const TableLayout &T = *T_;
+    const ColorRole innerProcBg = ColorRole::Overlay;
+    if (full)
+        FilledBox(g, T.box.top, T.box.left, T.box.height, T.box.width, L" Top processes ", innerProcBg, ColorRole::BoxProc);
+
+    const int maxRows = T.pageRows;
+
+    Pen pen(g);
+    pen.Bg(innerProcBg).At(T.headerRow, T.innerLeft);
+    HeaderLine(pen, T);
+    pen.ClearTo(T.innerRight);
+
+    g_procView.Update(*procs_, generation_, sort_, first_, maxRows);
+
+    const int bodyTop = T.bodyTop, bodyBottom = T.bodyTop + maxRows - 1;
+    if (scrolled_.first >= 0 && scrolled_.first != first_ &&
+        scrolled_.top == bodyTop && scrolled_.bottom == bodyBottom)
+        g.HintScroll(bodyTop, bodyBottom, first_ - scrolled_.first);
+    scrolled_ = {first_, bodyTop, bodyBottom};
+    paletteGen_ = ActivePalette().Generation();
+
+    rowFirst_ = g_procView.First();
+    rowCount_ = g_procView.Last() - rowFirst_;
+    // A band has to be long enough to pay for the hand-off.
+    bands_ = std::clamp(rowCount_ / 16, 1, std::max(1, bands));
+    // With several bands the cache is only read while they run; rows it
+    // missed are stored by Finish().
+    if (bands_ > 1)
+        missed_.assign((size_t)rowCount_, 0);
+    return bands_;
+}
+
+void ProcessTable::DrawBand(CellGrid &g, int band)
+{
+    DrawRows(g, rowFirst_ + rowCount_ * band / bands_, rowFirst_ + rowCount_ * (band + 1) / bands_,
+             paletteGen_, bands_ == 1);
+}
+
+void ProcessTable::Finish(CellGrid &g)
+{
+    const TableLayout &T = *T_;
+    const int bodyBottom = T.bodyTop + T.pageRows - 1;
+    if (bands_ > 1)
+        for (int i = 0; i < rowCount_; ++i)
+            if (missed_[i])
             {
-                int cut = std::min(over, cmdW - cmdW_min);
-                cmdW -= cut;
-                over -= cut;
+                const ProcInfo &p = g_procView.Row(rowFirst_ + i);
+                g_rowCache.Store(RowKey(p, rowFirst_ + i, paletteGen_), g.At(T.bodyTop + i, T.innerLeft));
             }
-            if (over > 0)
-                nameW = std::max(0, nameW - over);
 
-            put_eol_bg(f, innerRow++, innerLeftCol,
-                       apply_bg(HeaderLine(pidW, nameW, cmdW, thW, userW, memW, cpuW), innerProcBg),
-                       innerProcBg);
+    // Rows the list no longer reaches.
+    const int innerRow = T.bodyTop + rowCount_;
+    if (innerRow <= bodyBottom)
+        ClearInside(g, innerRow, T.innerLeft, bodyBottom - innerRow + 1, T.innerRight - T.innerLeft + 1, ColorRole::Overlay);
+    g_rowCache.EndFrame((size_t)std::max(64, 4 * T.pageRows));
+}
 
-            for (int i = first; i < (int)sorted.size() && innerRow < L.rows - 2; ++i)
-            {
-                const auto &p = sorted[i];
+void ProcessTable::Render(CellGrid &g, bool full)
+{
+    const int bands = Prepare(g, full, 1);
+    for (int b = 0; b < bands; ++b)
+        DrawBand(g, b);
+    Finish(g);
+}
+
+class Footer : public Widget
+{
+protected:
+    void Render(CellGrid &g, bool) override
+    {
+        Pen footer(g);
+        footer.Bg(ColorRole::Bg).At(rect_.top, rect_.left);
+        const std::pair<const wchar_t *, const wchar_t *> keys[] = {
+            {L"Q ", L"quit  "},
+            {L"F1 ", L"cpu%  "},
+            {L"F2 ", L"mem  "},
+            {L"F3 ", L"pid  "},
+            {L"F6 ", L"name  "},
+            {L"F5 ", L"Hz  "},
+            {L"PgUp/PgDn ", L"scroll  "},
+            {L"Esc/M ", L"menu  "},
+            {L"H ", L"help"},
+        };
+        for (const auto &[key, what] : keys)
+            footer.Fg(ColorRole::Dim).Text(key).Fg(ColorRole::Accent).Text(what);
+        footer.ClearTo(rect_.left + rect_.width - 1);
+    }
+};
+
+// The retained widget tree, in drawing order. A widget drawn in full
+// damages the ones after it that overlap it.
+static struct
+{
+    Backdrop backdrop;
+    CpuPanel cpu;
+    MemoryPanel mem;
+    DiskNetLine diskNet;
+    HistoryGraph cpuGraph{L" CPU history ", ColorRole::BoxCpu};
+    HistoryGraph memGraph{L" Memory history ", ColorRole::BoxMem};
+    ProcessTable table;
+    Footer footer;
+
+    uint64_t epoch = 0;
+    unsigned paletteGen = 0;
+
+    Widget *const all[8] = {&backdrop, &cpu, &mem, &diskNet, &cpuGraph, &memGraph, &table, &footer};
+} g_ui;
+
+void BuildFrame(
+    CellGrid &g,
+    const Layout &L,
+    double cpuUsage,
+    const MemInfo &mem,
+    const std::vector<ProcInfo> &procs,
+    unsigned long long generation,
+    int hz,
+    const std::vector<double> &perCoreCpu,
+    const std::wstring &netLine,
+    const std::wstring &diskLine,
+    const std::wstring &netSpark,
+    const std::wstring &diskSpark,
+    const Ring<double> &cpuHist,
+    const Ring<double> &memHist,
+    int procSort,
+    int procScroll,
+    int selectedIndex)
+{
+    g_layers.Fit(g);
+    CellGrid &base = g_layers.Base();
 
-                const std::wstring cmdToShow =
-                    (p.cmdline.empty() ? p.name : p.cmdline);
+    // A reset grid or a new palette leaves nothing worth keeping.
+    const unsigned paletteGen = ActivePalette().Generation();
+    if (base.Epoch() != g_ui.epoch || paletteGen != g_ui.paletteGen)
+    {
+        g_ui.epoch = base.Epoch();
+        g_ui.paletteGen = paletteGen;
+        g_ui.backdrop.Damage();
+    }
 
-                bool selected = (i == sel);
+    g_ui.backdrop.Place({1, 1, L.rows, L.cols});
+    g_ui.cpu.Place(L.cpu);
+    g_ui.cpu.Set(cpuUsage, hz, perCoreCpu, L.coreCols);
+    g_ui.mem.Place(L.mem);
+    g_ui.mem.Set(mem);
+    g_ui.diskNet.Place({(short)(L.mem.top + 6), L.mem.left, 2, L.mem.width});
+    g_ui.diskNet.Set(diskLine, diskSpark, netLine, netSpark);
+    g_ui.cpuGraph.Place(L.cpuGraph);
+    g_ui.cpuGraph.Set(cpuHist);
+    g_ui.memGraph.Place(L.memGraph);
+    g_ui.memGraph.Set(memHist);
+    g_ui.table.Place(L.table.box);
+    g_ui.table.Set(L.table, procs, generation, procSort, procScroll, selectedIndex);
+    g_ui.footer.Place({(short)(L.rows - 1), 2, 1, (short)(L.cols - 1)});
+
+    constexpr int n = (int)std::size(g_ui.all);
+    for (int i = 0; i < n; ++i)
+    {
+        const Widget *w = g_ui.all[i];
+        if (w->Bounds().Empty() || !w->Damaged())
+            continue;
+        for (int j = i + 1; j < n; ++j)
+            if (g_ui.all[j]->Bounds().Intersects(w->Bounds()))
+                g_ui.all[j]->Damage();
+    }
 
-                if (selected)
-                {
-                    std::wstringstream s;
-                    s << std::setw(pidW) << p.pid << L" "
-                      << Ellipsis(p.name, nameW) << L" "
-                      << MiddleEllipsis(cmdToShow, cmdW) << L" "
-                      << std::setw(thW) << p.threads << L" "
-                      << Ellipsis(p.user, userW) << L" "
-                      << PadRight(FormatBytesULONGLONG((ULONGLONG)p.workingSet), memW) << L" "
-                      << std::setw(cpuW) << std::fixed << std::setprecision(1) << p.cpu_percent;
-                    put_eol_bg(f, innerRow++, innerLeftCol, fg24(ActiveTheme().sel_fg) + s.str(), ActiveTheme().sel_bg);
-                    continue;
-                }
+    const bool parallel = g_pool.Workers() > 0 && (int)L.cols * L.rows >= g_parallel.minCells;
 
-                std::wstringstream ln;
-                ln << col_hdr() << std::setw(pidW) << p.pid << RST() << L" "
-                   << col_text() << Ellipsis(p.name, nameW) << RST() << L" "
-                   << col_dim() << MiddleEllipsis(cmdToShow, cmdW) << RST() << L" "
-                   << col_hdr() << std::setw(thW) << p.threads << RST() << L" "
-                   << col_dim() << Ellipsis(p.user, userW) << RST() << L" "
-                   << memCol << PadRight(FormatBytesULONGLONG((ULONGLONG)p.workingSet), memW) << RST() << L" ";
-                const auto col = (p.cpu_percent > 80) ? col_crit() : (p.cpu_percent > 50) ? col_warn()
-                                                                                          : col_ok();
-                ln << col << std::setw(cpuW) << std::fixed << std::setprecision(1) << p.cpu_percent << RST();
-                put_eol_bg(f, innerRow++, innerLeftCol, apply_bg(ln.str(), innerProcBg), innerProcBg);
-            }
+    // Widgets due this frame that overlap share a group and are drawn in
+    // order by one job; separate groups touch separate cells.
+    int group[n];
+    bool drawn[n] = {};
+    for (int i = 0; i < n; ++i)
+    {
+        group[i] = i;
+        const Widget *w = g_ui.all[i];
+        if (!parallel || w->Bounds().Empty() || !w->Due())
+            continue;
+        for (int j = 0; j < i; ++j)
+            if (g_ui.all[j]->Due() && g_ui.all[j]->Bounds().Intersects(w->Bounds()))
+                for (int k = 0, from = group[j]; k < i; ++k)
+                    if (group[k] == from)
+                        group[k] = i;
+    }
+    auto drawGroup = [&](int id)
+    {
+        for (int i = 0; i < n; ++i)
+            if (group[i] == id && !g_ui.all[i]->Bounds().Empty())
+                drawn[i] = g_ui.all[i]->Draw(base);
+    };
+
+    if (parallel)
+    {
+        // The table's rows go into the same batch as the other groups, ahead
+        // of them since they take longest. Whatever shares the table's group
+        // is drawn before or after the batch, in order.
+        const int t = (int)(std::find(g_ui.all, g_ui.all + n, &g_ui.table) - g_ui.all);
+        const int tableGroup = group[t];
+        const bool tableShown = !g_ui.table.Bounds().Empty();
+        for (int i = 0; i < t; ++i)
+            if (group[i] == tableGroup && !g_ui.all[i]->Bounds().Empty())
+                drawn[i] = g_ui.all[i]->Draw(base);
+        bool full = false;
+        int bands = 0;
+        if (tableShown && g_ui.table.Claim(full))
+        {
+            drawn[t] = true;
+            bands = g_ui.table.Prepare(base, full, g_pool.Workers() + 1);
         }
+
+        int jobs[n], jobCount = 0;
+        for (int i = 0; i < n; ++i)
+            if (group[i] == i && i != tableGroup && g_ui.all[i]->Due() && !g_ui.all[i]->Bounds().Empty())
+                jobs[jobCount++] = i;
+        g_pool.Run(bands + jobCount, [&](int j)
+                   {
+                       if (j < bands)
+                           g_ui.table.DrawBand(base, j);
+                       else
+                           drawGroup(jobs[j - bands]);
+                   });
+
+        if (bands > 0)
+            g_ui.table.Finish(base);
+        for (int i = t + 1; i < n; ++i)
+            if (group[i] == tableGroup && !g_ui.all[i]->Bounds().Empty())
+                drawn[i] = g_ui.all[i]->Draw(base);
     }
+    else
+        for (int i = 0; i < n; ++i)
+            drawGroup(i);
+
+    for (int i = 0; i < n; ++i)
+        if (drawn[i])
+            g_layers.BaseChanged(g_ui.all[i]->Bounds());
+}
 
-    put_eol_bg(f, L.rows - 1, 2,
-               apply_bg(
-                   col_dim() + L"Q " + col_accent() + L"quit  " +
-                       col_dim() + L"F1 " + col_accent() + L"cpu%  " +
-                       col_dim() + L"F2 " + col_accent() + L"mem  " +
-                       col_dim() + L"F3 " + col_accent() + L"pid  " +
-                       col_dim() + L"F6 " + col_accent() + L"name  " +
-                       col_dim() + L"F5 " + col_accent() + L"Hz  " +
-                       col_dim() + L"PgUp/PgDn " + col_accent() + L"scroll  " +
-                       col_dim() + L"Esc/M " + col_accent() + L"menu  " +
-                       col_dim() + L"H " + col_accent() + L"help",
-                   ActiveTheme().bg),
-               ActiveTheme().bg);
-
-    return f;
+void SetParallelRender(int workers, int minCells)
+{
+    g_parallel.workers = std::max(0, workers);
+    g_parallel.minCells = minCells;
+    if (g_pool.Workers() != g_parallel.workers)
+        g_pool.start(g_parallel.workers);
 }
 
-std::wstring BuildOverlayMainMenu(const Layout &L, const AppState &st)
+static Rect BuildOverlayMainMenu(CellGrid &g, const Layout &L, int menuIndex)
 {
     const std::wstring title = L"BTOP++ for Windows";
     const short w = (short)std::max<int>(40, (int)title.size() + 8);
@@ -482,47 +830,43 @@ std::wstring BuildOverlayMainMenu(const Layout &L, const AppState &st)
     short top = (short)std::max<short>(1, (L.rows - h) / 2);
     short left = (short)std::max<short>(2, (L.cols - w) / 2);
 
-    std::wstring f;
-    FillRectBG(f, top, left, h, w, ActiveTheme().overlay);
-    Box(f, top, left, h, w, L" Menu ", ActiveTheme().overlay);
+    FillRectBG(g, top, left, h, w, ColorRole::Overlay);
+    Box(g, top, left, h, w, L" Menu ", ColorRole::Overlay);
 
     const std::wstring items[3] = {L"Options", L"Help", L"Quit"};
     short listTop = (short)(top + 2);
     short listLeft = (short)(left + 2);
+    Pen p(g);
     for (int i = 0; i < 3; ++i)
     {
-        const bool sel = (i == st.menuIndex);
-        std::wstring line = sel
-                                ? (bg24(ActiveTheme().sel_bg) + fg24(ActiveTheme().sel_fg) + L"> " + items[i] + RST())
-                                : (col_text() + L"  " + items[i] + RST());
-        put(f, (short)(listTop + i), listLeft, apply_bg(line, ActiveTheme().overlay));
+        p.At(listTop + i, listLeft);
+        if (i == menuIndex)
+            p.Bg(ColorRole::SelBg).Fg(ColorRole::SelFg).Text(L"> ").Text(items[i]);
+        else
+            p.Bg(ColorRole::Overlay).Fg(ColorRole::Text).Text(L"  ").Text(items[i]);
     }
+    p.Bg(ColorRole::Overlay);
 
     short infoLeft = (short)(left + w / 2);
     int rightW = (left + w - 2) - infoLeft;
     rightW = std::max(rightW, 10);
 
-    auto clip = [&](std::wstring s)
-    { return Ellipsis(std::move(s), (size_t)rightW); };
-
-    put(f, (short)(top + 2), infoLeft, apply_bg(col_hdr() + clip(title), ActiveTheme().overlay));
-    put(f, (short)(top + 3), infoLeft, apply_bg(col_dim() + clip(L"Description"), ActiveTheme().overlay));
-    put(f, (short)(top + 4), infoLeft,
-        apply_bg(col_text() + clip(L"Theme & colors. Pick visual style that suits you."), ActiveTheme().overlay));
+    FmtEllipsis(p.At(top + 2, infoLeft).Fg(ColorRole::Hdr), title, rightW);
+    FmtEllipsis(p.At(top + 3, infoLeft).Fg(ColorRole::Dim), L"Description", rightW);
+    FmtEllipsis(p.At(top + 4, infoLeft).Fg(ColorRole::Text), L"Theme & colors. Pick visual style that suits you.", rightW);
 
     const int innerW = w - 4;
-    const std::wstring hint_long = L"[↑/↓] select   [Enter] open   [Esc] close";
-    const std::wstring hint_short = L"↑/↓  Enter  Esc";
-    std::wstring hint = ((int)hint_long.size() <= innerW) ? hint_long
-                                                          : Ellipsis(hint_short, (size_t)innerW);
-
-    put(f, (short)(top + h - 2), (short)(left + 2),
-        apply_bg(col_dim() + hint, ActiveTheme().overlay));
-
-    return f;
+    const std::wstring_view hint_long = L"[↑/↓] select   [Enter] open   [Esc] close";
+    const std::wstring_view hint_short = L"↑/↓  Enter  Esc";
+    p.At(top + h - 2, left + 2).Fg(ColorRole::Dim);
+    if ((int)hint_long.size() <= innerW)
+        p.Text(hint_long);
+    else
+        FmtEllipsis(p, hint_short, innerW);
+    return {top, left, h, w};
 }
 
-std::wstring BuildOverlayThemePicker(const Layout &L, const std::wstring &currentThemeName)
+static Rect BuildOverlayThemePicker(CellGrid &g, const Layout &L, const std::wstring &currentThemeName)
 {
     const std::wstring title = L"Options — Theme";
     const short w = (short)std::max<int>(36, (int)title.size() + 6);
@@ -530,12 +874,12 @@ std::wstring BuildOverlayThemePicker(const Layout &L, const std::wstring &curren
     short top = (short)std::max<short>(1, (L.rows - h) / 2);
     short left = (short)std::max<short>(2, (L.cols - w) / 2);
 
-    std::wstring f;
-    FillRectBG(f, top, left, h, w, ActiveTheme().overlay);
-    Box(f, top, left, h, w, L" Options ", ActiveTheme().overlay);
+    FillRectBG(g, top, left, h, w, ColorRole::Overlay);
+    Box(g, top, left, h, w, L" Options ", ColorRole::Overlay);
 
-    put(f, (short)(top + 1), (short)(left + (w - (short)title.size()) / 2),
-        apply_bg(col_hdr() + title, ActiveTheme().overlay));
+    Pen p(g);
+    p.Bg(ColorRole::Overlay);
+    p.At(top + 1, left + (w - (int)title.size()) / 2).Fg(ColorRole::Hdr).Text(title);
 
     const int innerW = w - 2;
     const int padL = 3;
@@ -543,10 +887,8 @@ std::wstring BuildOverlayThemePicker(const Layout &L, const std::wstring &curren
 
     const std::wstring prefix = L"Theme: ";
     int maxNameW = std::max(0, textW - (int)prefix.size());
-    std::wstring nameTrim = MiddleEllipsis(currentThemeName, (size_t)maxNameW);
-
-    put(f, (short)(top + 3), (short)(left + padL),
-        apply_bg(col_text() + prefix + col_accent() + nameTrim, ActiveTheme().overlay));
+    p.At(top + 3, left + padL).Fg(ColorRole::Text).Text(prefix).Fg(ColorRole::Accent);
+    FmtMiddleEllipsis(p, currentThemeName, maxNameW);
 
     auto fits = [&](const std::wstring &s)
     { return (int)s.size() + 2 <= textW; };
@@ -555,44 +897,42 @@ std::wstring BuildOverlayThemePicker(const Layout &L, const std::wstring &curren
     const std::wstring hint_short = L"←/↑  →/↓  Enter/Esc";
     const std::wstring hint_ascii = L"Up/Down  Enter/Esc";
 
-    std::wstring hint;
+    p.At(top + 5, left + padL).Fg(ColorRole::Dim);
     if (fits(hint_long))
-        hint = hint_long;
+        p.Text(hint_long);
     else if (fits(hint_mid))
-        hint = hint_mid;
+        p.Text(hint_mid);
     else if (fits(hint_short))
-        hint = hint_short;
+        p.Text(hint_short);
     else
-        hint = Ellipsis(hint_ascii, (size_t)std::max(0, textW));
-
-    put(f, (short)(top + 5), (short)(left + padL),
-        apply_bg(col_dim() + hint, ActiveTheme().overlay));
-
-    return f;
+        FmtEllipsis(p, hint_ascii, textW);
+    return {top, left, h, w};
 }
 
-std::wstring BuildOverlayHelp(const Layout &L)
+static Rect BuildOverlayHelp(CellGrid &g, const Layout &L)
 {
     const short w = (short)std::min<int>(L.cols - 8, 78);
     const short h = (short)std::min<int>(L.rows - 6, 18);
     short top = (short)std::max<short>(1, (L.rows - h) / 2);
     short left = (short)std::max<short>(2, (L.cols - w) / 2);
 
-    std::wstring f;
-    FillRectBG(f, top, left, h, w, ActiveTheme().overlay);
-    Box(f, top, left, h, w, L" Help ", ActiveTheme().overlay);
+    FillRectBG(g, top, left, h, w, ColorRole::Overlay);
+    Box(g, top, left, h, w, L" Help ", ColorRole::Overlay);
 
     short r = (short)(top + 2);
     short c = (short)(left + 2);
+    const int innerRight = left + w - 2;
 
+    Pen p(g);
+    p.Bg(ColorRole::Overlay);
     auto line = [&](std::wstring k, std::wstring d)
     {
-        std::wstringstream ss;
-        ss << col_accent() << PadRight(std::move(k), 10) << RST() << L"  " << col_text() << d << RST();
-        put_eol_bg(f, r++, c, apply_bg(ss.str(), ActiveTheme().overlay), ActiveTheme().overlay);
+        FmtPad(p.At(r++, c).Fg(ColorRole::Accent), k, 10);
+        p.Text(L"  ");
+        p.Fg(ColorRole::Text).Text(d).ClearTo(innerRight);
     };
 
-    put(f, r++, c, apply_bg(col_hdr() + L"Keys — Description", ActiveTheme().overlay));
+    p.At(r++, c).Fg(ColorRole::Hdr).Text(L"Keys — Description");
     r++;
 
     line(L"Q", L"Quit program");
@@ -605,7 +945,58 @@ std::wstring BuildOverlayHelp(const Layout &L)
     line(L"↑/↓/Home/End", L"Navigation");
 
     r++;
-    put(f, (short)(top + h - 2), (short)(left + 2),
-        apply_bg(col_dim() + L"[Esc/Enter] back", ActiveTheme().overlay));
-    return f;
+    p.At(top + h - 2, left + 2).Fg(ColorRole::Dim).Text(L"[Esc/Enter] back");
+    return {top, left, h, w};
+}
+
+// What the overlay layer was last drawn from.
+static struct
+{
+    uint64_t epoch = 0;
+    UiMode mode = UiMode::Normal;
+    int menuIndex = -1;
+    std::wstring theme;
+    short cols = 0, rows = 0;
+    unsigned paletteGen = 0;
+} g_overlayDrawn;
+
+void ComposeFrame(CellGrid &g, const Layout &L, const AppState &st, const std::wstring &themeName)
+{
+    g_layers.Fit(g);
+    CellGrid &top = g_layers.Top();
+    const unsigned paletteGen = ActivePalette().Generation();
+    auto &d = g_overlayDrawn;
+    if (d.epoch != top.Epoch() || d.mode != st.ui || d.menuIndex != st.menuIndex || d.theme != themeName ||
+        d.cols != L.cols || d.rows != L.rows || d.paletteGen != paletteGen)
+    {
+        d.epoch = top.Epoch();
+        d.mode = st.ui;
+        d.menuIndex = st.menuIndex;
+        d.theme = themeName;
+        d.cols = L.cols;
+        d.rows = L.rows;
+        d.paletteGen = paletteGen;
+
+        Rect r;
+        if (st.ui == UiMode::MainMenu)
+            r = BuildOverlayMainMenu(top, L, st.menuIndex);
+        else if (st.ui == UiMode::ThemePicker)
+            r = BuildOverlayThemePicker(top, L, themeName);
+        else if (st.ui == UiMode::Help)
+            r = BuildOverlayHelp(top, L);
+        g_layers.OverlayChanged(r);
+    }
+    g_layers.Compose(g);
+}
+
+RowCacheStats GetRowCacheStats()
+{
+    return {g_rowCache.Hits(), g_rowCache.Misses()};
+}
+
+void DrawFrameStats(CellGrid &g, const Layout &L, const std::wstring &text)
+{
+    short col = (short)std::max<int>(1, L.cols - (int)text.size());
+    // The margin row is only painted on resize; clear what a longer line left.
+    Pen(g).Bg(ColorRole::Panel).At(L.rows, 1).Fill(U' ', col - 1).Fg(ColorRole::Dim).Text(text);
 }
@@ -3,39 +3,86 @@
 #include <vector>
 #include "metrics.h"
 #include "state.h"
+#include "screen.h"
+#include "widget.h"
+#include "proc_columns.h"
 
+// Process table box and columns; optional columns that do not fit are left
+// out of `columns` and have width 0.
+struct TableLayout
+{
+    Rect box;
+    short headerRow = 0, bodyTop = 0;
+    short innerLeft = 0, innerRight = 0;
+    // Process rows visible between the header and the bottom border.
+    int pageRows = 1;
+    uint32_t columns = 0;
+    short colW[kProcColCount] = {};
+};
+
+// Everything that depends only on the console size. Computed once per
+// resize; the frame builders only read from it.
 struct Layout
 {
     short cols = 0, rows = 0;
     short left = 1, top = 1, right = 1, bottom = 1;
     short panelWidth = 0;
-};
+    // Height of the CPU/memory history band under the top panels; 0 when
+    // the console is too short for it.
+    short graphHeight = 0;
 
-struct TableMetrics
-{
-    int tableTop;
-    int pageRows;
+    Rect cpu, mem;
+    // Zero-sized when not drawn.
+    Rect cpuGraph, memGraph;
+    // Per-core bars per row in the CPU panel.
+    short coreCols = 1;
+    TableLayout table;
 };
 
-Layout ComputeLayout();
-TableMetrics ComputeTableMetrics(const Layout &L);
+Layout ComputeLayout(short cols, short rows);
 
-std::wstring BuildFrame(
+// Renders the panels into the retained base layer, which is sized to match
+// `g`. Only reads the size of `g`; ComposeFrame() writes it.
+void BuildFrame(
+    CellGrid &g,
     const Layout &L,
     double cpuUsage,
     const MemInfo &mem,
     const std::vector<ProcInfo> &procs,
+    unsigned long long generation,
     int hz,
     const std::vector<double> &perCoreCpu,
     const std::wstring &netLine,
     const std::wstring &diskLine,
     const std::wstring &netSpark,
     const std::wstring &diskSpark,
+    const Ring<double> &cpuHist,
+    const Ring<double> &memHist,
     int procSort,
     int procScroll,
-    int selectedIndex = -1,
-    int totalCount = 0);
+    int selectedIndex = -1);
+
+// Draws the panels on `workers` threads besides the caller once the
+// console has at least `minCells` cells; smaller frames stay serial. Off
+// (0 workers) unless called.
+void SetParallelRender(int workers, int minCells);
+
+// Where the app switches to parallel drawing. Handing panels to the pool
+// costs about 5 us a frame (render_bench, 5x24 vs serial); from 200x60 up a
+// serial frame takes 100 us or more, so the split has room to pay off.
+constexpr int kParallelMinCells = 200 * 60;
+
+// Renders the overlay for `st.ui`, if any, into the overlay layer when it
+// changed, then copies both layers into `g`. Only cells that changed in
+// either layer since the last call are written to `g`.
+void ComposeFrame(CellGrid &g, const Layout &L, const AppState &st, const std::wstring &themeName);
+
+// Process rows reused from / formatted into the row cache since startup.
+struct RowCacheStats
+{
+    uint64_t hits = 0, misses = 0;
+};
+RowCacheStats GetRowCacheStats();
 
-std::wstring BuildOverlayMainMenu(const Layout &L, const AppState &st);
-std::wstring BuildOverlayThemePicker(const Layout &L, const std::wstring &currentThemeName);
-std::wstring BuildOverlayHelp(const Layout &L);
+// Right-aligned diagnostics on the bottom margin row (WINBTOP_STATS=1).
+void DrawFrameStats(CellGrid &g, const Layout &L, const std::wstring &text);
@@ -1,8 +1,10 @@
 #pragma once
 #include <string>
 #include <deque>
+#include <vector>
 #include <algorithm>
 #include <cmath>
+#include "state.h"
 
 inline std::wstring spark_braille(const std::deque<double> &vals, int width)
 {
@@ -59,3 +61,124 @@ inline std::wstring spark_braille(const std::deque<double> &vals, int width)
     }
     return out;
 }
+
+// What a Sync() did to the picture: it moved left by `shifted` columns and
+// the newest `fresh` columns hold new glyphs. Everything else is the old
+// picture, `shifted` columns further left.
+struct GraphChange
+{
+    int shifted = 0;
+    int fresh = 0;
+};
+
+// Scrolling multi-row braille graph of percentages (fixed 0..100 scale).
+// Every cell column holds two samples; columns live in a ring, so a new
+// sample only recomputes the newest column: O(rows), not O(width * rows).
+class BrailleGraph
+{
+public:
+    // Returns true (and clears the graph) when the size changed.
+    bool Resize(int width, int rows)
+    {
+        width = std::max(0, width);
+        rows = std::max(0, rows);
+        if (width == width_ && rows == rows_)
+            return false;
+        width_ = width;
+        rows_ = rows;
+        cells_.assign((size_t)width_ * rows_, U' ');
+        head_ = 0;
+        half_ = false;
+        seen_ = 0;
+        return true;
+    }
+
+    void Push(double percent)
+    {
+        if (width_ == 0 || rows_ == 0)
+            return;
+        const int dots = rows_ * 4;
+        int level = (int)std::lround(std::clamp(percent, 0.0, 100.0) / 100.0 * dots);
+        if (percent > 0.0 && level == 0)
+            level = 1;
+
+        if (!half_)
+        {
+            head_ = (head_ + 1) % width_;
+            left_ = level;
+            Compose(left_, 0);
+        }
+        else
+            Compose(left_, level);
+        half_ = !half_;
+    }
+
+    // Pushes whatever `hist` gained since the last Sync(). After a resize
+    // the graph is refilled from everything the ring still holds.
+    GraphChange Sync(const Ring<double> &hist)
+    {
+        const auto &d = hist.data();
+        unsigned long long fresh = hist.pushed() - seen_;
+        fresh = std::min<unsigned long long>(fresh, std::min<size_t>(d.size(), (size_t)width_ * 2));
+        // Pair samples by their absolute index so a rebuilt graph lines up
+        // with one that was fed incrementally.
+        if (seen_ == 0 && ((hist.pushed() - fresh) & 1))
+        {
+            half_ = true;
+            left_ = 0;
+        }
+        GraphChange ch;
+        // Finishing the right half of the newest column redraws it in place.
+        bool touchedNewest = false;
+        for (auto it = d.end() - (std::ptrdiff_t)fresh; it != d.end(); ++it)
+        {
+            if (half_ && ch.shifted == 0)
+                touchedNewest = true;
+            else if (!half_)
+                ++ch.shifted;
+            Push(*it);
+        }
+        seen_ = hist.pushed();
+        ch.shifted = std::min(ch.shifted, width_);
+        ch.fresh = std::min(ch.shifted + (touchedNewest ? 1 : 0), width_);
+        return ch;
+    }
+
+    int Width() const { return width_; }
+    int Rows() const { return rows_; }
+
+    // Glyph at `row` (0 = top) and `col` (0 = oldest).
+    char32_t At(int row, int col) const
+    {
+        const int idx = (head_ + 1 + col) % width_;
+        return cells_[(size_t)idx * rows_ + row];
+    }
+
+private:
+    // Fills the newest column from two dot heights (0..rows*4).
+    void Compose(int left, int right)
+    {
+        // Braille dots from the bottom of a cell up: left 7,3,2,1; right 8,6,5,4.
+        static constexpr int leftBits[4] = {0x40, 0x04, 0x02, 0x01};
+        static constexpr int rightBits[4] = {0x80, 0x20, 0x10, 0x08};
+        char32_t *col = &cells_[(size_t)head_ * rows_];
+        for (int r = 0; r < rows_; ++r)
+        {
+            const int base = (rows_ - 1 - r) * 4;
+            const int l = std::clamp(left - base, 0, 4), rr = std::clamp(right - base, 0, 4);
+            int mask = 0;
+            for (int i = 0; i < l; ++i)
+                mask |= leftBits[i];
+            for (int i = 0; i < rr; ++i)
+                mask |= rightBits[i];
+            col[r] = mask ? (char32_t)(0x2800 + mask) : U' ';
+        }
+    }
+
+    int width_ = 0, rows_ = 0;
+    std::vector<char32_t> cells_; // column-major: width_ columns of rows_ glyphs
+    int head_ = 0;                // ring slot of the newest column
+    bool half_ = false;           // newest column has only its left half
+    int left_ = 0;
+    unsigned long long seen_ = 0;
+};
@@ -0,0 +1,83 @@
+#pragma once
+#include "screen.h"
+
+struct Rect
+{
+    short top = 0, left = 0, height = 0, width = 0;
+
+    bool operator==(const Rect &) const = default;
+    bool Empty() const { return height <= 0 || width <= 0; }
+    bool Intersects(const Rect &o) const
+    {
+        return !Empty() && !o.Empty() &&
+               top < o.top + o.height && o.top < top + height &&
+               left < o.left + o.width && o.left < left + width;
+    }
+};
+
+// A retained part of the frame that owns one rectangle of the back buffer.
+// It is drawn again only when one of its inputs changed (contents only) or
+// when its cells were lost: moved rectangle, new theme, something drawn on
+// top (frame and contents).
+class Widget
+{
+public:
+    virtual ~Widget() = default;
+
+    const Rect &Bounds() const { return rect_; }
+    void Place(const Rect &r)
+    {
+        if (!(r == rect_))
+        {
+            rect_ = r;
+            damaged_ = true;
+        }
+    }
+    void Damage() { damaged_ = true; }
+    bool Damaged() const { return damaged_; }
+    // Draw() would draw something.
+    bool Due() const { return damaged_ || changed_; }
+
+    // Returns true when anything was drawn.
+    bool Draw(CellGrid &g)
+    {
+        bool full;
+        if (!Claim(full))
+            return false;
+        Render(g, full);
+        return true;
+    }
+
+    // For widgets drawn in steps outside Draw(): returns false when nothing
+    // is due, otherwise marks the widget drawn and sets `full` as Render()
+    // would get it.
+    bool Claim(bool &full)
+    {
+        if (!damaged_ && !changed_)
+            return false;
+        full = damaged_;
+        damaged_ = changed_ = false;
+        return true;
+    }
+
+protected:
+    // `full` asks for the static parts (box, labels) as well.
+    virtual void Render(CellGrid &g, bool full) = 0;
+
+    // Setters route every input through here so a changed value marks the
+    // contents stale; assignment keeps the held value's capacity.
+    template <typename T>
+    void Update(T &held, const T &next)
+    {
+        if (!(held == next))
+        {
+            held = next;
+            changed_ = true;
+        }
+    }
+
+    Rect rect_;
+
+private:
+    bool damaged_ = true, changed_ = true;
+};